@@ -5,6 +5,7 @@
 #endif /* CONFIG_64BIT */
 
 #define BITS_PER_BYTE           8
+#define BITS_PER_LONG_LONG      64
 #define DIV_ROUND_UP(n,d) (((n) + (d) - 1) / (d))
 
 #define BIT(nr)                 (1U << (nr))
@@ -15,6 +16,7 @@
 #define BIT_ULL_WORD(nr)        ((nr) / BITS_PER_LONG_LONG)
 
 #define BITS_TO_LONGS(nr)       DIV_ROUND_UP(nr, BITS_PER_BYTE * sizeof(long))
+#define BITS_TO_LONG_LONGS(nr)  DIV_ROUND_UP(nr, BITS_PER_LONG_LONG)
 
 #define BIT_ULL_MASK(nr)        (1ULL << ((nr) % BITS_PER_LONG_LONG))
 #define BIT_ULL_WORD(nr)        ((nr) / BITS_PER_LONG_LONG)
@@ -14,6 +14,8 @@
 #include "os-mm.h"
 #endif
 
+#include "rbtree.h"
+
 #define ADDRESS_SIZE 20
 #define OFFSET_LEN 10
 #define FIRST_LV_LEN 5
@@ -32,6 +34,9 @@ enum ins_opcode_t
 	READ,  // Write data to a byte on memory
 	WRITE, // Read data from a byte on memory
 	SYSCALL,
+	MEMSET, // Set a span of a memory region to one value
+	MEMCPY, // Copy a span between memory regions
+	MEMCMP, // Compare spans of memory regions
 };
 
 /* instructions executed by the CPU */
@@ -42,12 +47,32 @@ struct inst_t
 	uint32_t arg_1;
 	uint32_t arg_2;
 	uint32_t arg_3;
+	uint32_t arg_4;
+	uint32_t arg_5;
+};
+
+/* An instruction pre-decoded by decode(): the address of its handler
+ * in the interpreter and its operands */
+struct op_t
+{
+	const void *handler;
+	uint32_t arg_0;
+	uint32_t arg_1;
+	uint32_t arg_2;
+	uint32_t arg_3;
+	uint32_t arg_4;
+	uint32_t arg_5;
+	uint32_t calc_run; // Consecutive CALC from this one on, 0 if not CALC
 };
 
 struct code_seg_t
 {
 	struct inst_t *text;
+	struct op_t *ops; // text pre-decoded, what run() executes
 	uint32_t size;
+	int refs; // PCBs and image cache sharing it, see loader.c
+	void *map; // Mapping of a compiled program holding text, or NULL
+	size_t map_len;
 };
 
 struct trans_table_t
@@ -74,6 +99,23 @@ struct page_table_t
 };
 
 /* PCB, describe information about a process */
+/* Slots of the per-syscall counters: one per syscall table entry and a
+ * last one for unknown numbers, syscall.c checks that they fit */
+#define PERF_MAX_SYSCALLS 16
+
+/* Performance counters of a process. Only the CPU running the process
+ * updates them, so they are plain integers */
+struct perf_count_t
+{
+	uint64_t instructions;	// Instructions retired
+	uint32_t nr_alloc;
+	uint32_t nr_free;
+	uint32_t page_faults;	// Missing pages brought in by pg_getpage()
+	uint32_t swap_in;
+	uint32_t swap_out;
+	uint32_t syscalls[PERF_MAX_SYSCALLS]; // By syscall table entry
+};
+
 struct pcb_t
 {
 	uint32_t pid;		 // PID
@@ -84,12 +126,16 @@ struct pcb_t
 	uint32_t pc;		 // Program pointer, point to the next instruction
 	struct queue_t *ready_queue;
 	struct queue_t *running_list;
+	struct pcb_t *admit_next; // Link in the scheduler admission stack
 #ifdef MLQ_SCHED
 	struct queue_t *mlq_ready_queue;
 	// Priority on execution (if supported), on-fly aka. changeable
 	// and this vale overwrites the default priority when it existed
 	uint32_t prio;
 #endif
+	/* Virtual runtime and timeline node of the CFS policy */
+	uint64_t vruntime;
+	struct rb_node run_node;
 #ifdef MM_PAGING
 	struct mm_struct *mm;
 	struct memphy_struct *mram;
@@ -99,6 +145,16 @@ struct pcb_t
 #endif
 	struct page_table_t *page_table; // Page table
 	uint32_t bp;			 // Break pointer
+
+	/* Latency accounting in time slots, stamped by the scheduler */
+	uint64_t arrival_time;		// Admitted by add_proc()
+	uint64_t first_dispatch_time;
+	uint64_t ready_time;		// Last time it entered a ready queue
+	uint64_t wait_time;		// Total time spent in ready queues
+	uint64_t finish_time;
+	uint32_t nr_dispatch;
+
+	struct perf_count_t perf;
 };
 
 #endif
@@ -6,8 +6,20 @@
 
 /* Execute an instruction of a process. Return 0
  * if the instruction is executed successfully.
- * Otherwise, return 1. */
+ * Otherwise, return 1. The code of the process has
+ * to be decoded already. */
 int run(struct pcb_t * proc);
 
+/* Pre-decode the text of a code segment for run(), once after loading */
+void decode(struct code_seg_t * code);
+
+/* Number of CALC instructions in a row from the program counter of the
+ * process on, which have no side effect besides taking time */
+uint32_t calc_ahead(struct pcb_t * proc);
+
+/* Retire the next [n] instructions in one step, like [n] run() calls.
+ * All of them must be CALC, n <= calc_ahead(proc) */
+void run_calc(struct pcb_t * proc, uint32_t n);
+
 #endif
 
@@ -0,0 +1,98 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include "trace.h"
+
+#include <stdint.h>
+
+/* Binary event trace, enabled by the "trace <path>" config option. The
+ * file is an event_hdr_t and then fixed-size event_t records in timeline
+ * order, in host byte order. Variable data, such as a program path or a
+ * page table, follows its event in [more] EV_DATA records. ossim-trace
+ * renders the file back as the text the simulator would have printed.
+ *
+ * An event is recorded instead of its text line, the lines without an
+ * event type are still printed */
+#define EVENT_MAGIC	0x5645534f	/* "OSEV" */
+#define EVENT_VERSION	2
+
+enum event_type_t {
+	EV_SLOT,	// Start of a time slot
+	EV_LD_START,	// Loader started
+	EV_LOAD,	// Process admitted: prio, data = program path
+	EV_DISPATCH,	// cpu
+	EV_PREEMPT,	// Put back to the run queue: cpu
+	EV_FINISH,	// cpu
+	EV_CPU_STOP,	// cpu
+	EV_SYSCALL,	// nr, a1, a2, a3
+	EV_ALLOC,	// region, address, size, data = page table
+	EV_FREE,	// region, data = page table
+	EV_READ,	// region, offset, value, data = page table
+	EV_WRITE,	// region, offset, value, data = page table
+	EV_MEMSET,	// region, offset, value, size, data = page table
+	EV_MEMCPY,	// dst region, offset, src region, offset, size,
+			// data = page table
+			// The last argument of these four is set when the
+			// banner dumps the physical memory
+	EV_MEMCMP,	// region a, offset, region b, offset, size, result
+	EV_FAULT,	// page number
+	EV_SWAP,	// Page copy: src device, frame, dst device, frame
+	EV_STORE,	// RAM byte store: address, value, printed
+	EV_FILL,	// RAM fill: address, value, size
+	EV_MOVE,	// RAM move: dst address, src address, size
+	EV_MEMPHY,	// Memory device: id, size. RAM is device 0
+	EV_FRAMES,	// Free frames of a device changed: id, free frames
+	EV_DATA,	// Payload of the previous event
+	EV_MAX
+};
+
+/* A page table payload is the end of the vm area and then its entries,
+ * as uint32_t. Events of the categories turned off are not recorded,
+ * but for the physical memory changes */
+
+#define EVENT_NARGS	6
+
+struct event_t {
+	uint64_t time;
+	uint16_t type;
+	uint16_t more;		// EV_DATA records following
+	uint32_t pid;
+	int32_t arg[EVENT_NARGS];
+};
+
+struct event_hdr_t {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t size;		// sizeof(struct event_t)
+};
+
+/* Set while the trace file is open */
+extern int event_on;
+
+/* Start recording to [path]. Return 0 on success */
+int event_open(const char * path);
+
+void event_close(void);
+
+/* Record an event with [len] bytes of payload */
+void event_emit(int type, uint32_t pid, const int32_t * arg,
+		const void * data, uint32_t len);
+
+#define EVENT(type, pid, ...) do { \
+	int32_t __arg[EVENT_NARGS] = { __VA_ARGS__ }; \
+	event_emit(type, pid, __arg, NULL, 0); \
+} while (0)
+
+/* Log a record of category [cat]: event [type] with the arguments in
+ * parentheses [args] while the trace file is open, else the text line
+ * formatted from the rest */
+#define TRACE_EVENT(cat, type, pid, args, ...) do { \
+	if (TRACE_ON(cat) && event_on) \
+		EVENT(type, pid, EVENT_ARGS args); \
+	else if (TRACE_ON(cat)) \
+		trace_printf(__VA_ARGS__); \
+} while (0)
+
+#define EVENT_ARGS(...) __VA_ARGS__
+
+#endif
@@ -3,7 +3,36 @@
 
 #include "common.h"
 
+/* Compiled programs, written by ossim-as: a prog_hdr_t followed by
+ * [size] fixed-width inst_t records, in host byte order. The loader maps
+ * the records in place as the code segment text */
+#define PROG_MAGIC	0x4d49534f	/* "OSIM" */
+#define PROG_VERSION	2
+/* A compiled copy of a program sits next to it with this suffix */
+#define PROG_SUFFIX	".bin"
+
+struct prog_hdr_t {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t priority;	// Default priority of the processes
+	uint32_t size;		// Number of instructions
+};
+
+/* Create a PCB running the program at [path]. The code segment is shared
+ * with the other processes of the same program. The PID is left to the
+ * caller, os hands them out in arrival order */
 struct pcb_t * load(const char * path);
 
+/* Parse the text program at [path] into a new code segment, with no
+ * reference yet. [priority] is the default one from the file header */
+struct code_seg_t * parse_program(const char * path, uint32_t * priority);
+
+/* Drop the reference of [proc] to its code segment */
+void unload(struct pcb_t * proc);
+
+/* Empty the program image cache. Code segments still in use are freed
+ * when their last process is unloaded */
+void flush_images(void);
+
 #endif
 
@@ -8,7 +8,6 @@
 //#define MM_FIXED_MEMSZ
 //#define VMDBG 1
 //#define MMDBG 1
-#define IODUMP 1
-#define PAGETBL_DUMP 1
+/* The memory dumps are trace categories, chosen at run time */
 
 #endif
@@ -73,6 +73,7 @@ struct memphy_struct {
    /* Basic field of data and size */
    BYTE *storage;
    int maxsz;
+   int id;        /* Device number in the event trace, RAM is 0 */
    
    /* Sequential device fields */ 
    int rdmflg;
@@ -81,6 +82,11 @@ struct memphy_struct {
    /* Management structure */
    struct framephy_struct *free_fp_list;
    struct framephy_struct *used_fp_list;
+   int nr_free;   /* Length of free_fp_list */
+
+   /* One bit per frame, set once a non-zero byte may have been written
+    * to it. MEMPHY_dump() only visits the frames with their bit set */
+   unsigned long *used_frames;
 };
 
 #endif
@@ -4,11 +4,15 @@
 
 #include "common.h"
 
+/* Initial capacity of a queue, it doubles whenever the queue is full */
 #define MAX_QUEUE_SIZE 10
 
+/* Growable ring buffer of processes, a zeroed queue_t is an empty queue */
 struct queue_t {
-	struct pcb_t * proc[MAX_QUEUE_SIZE];
+	struct pcb_t ** proc;
+	int head;	// Index of the first process in proc[]
 	int size;
+	int capacity;
 };
 
 void enqueue(struct queue_t * q, struct pcb_t * proc);
@@ -17,5 +21,17 @@ struct pcb_t * dequeue(struct queue_t * q);
 
 int empty(struct queue_t * q);
 
+/* Return the [i]-th process from the head of [q] */
+struct pcb_t * queue_at(struct queue_t * q, int i);
+
+/* Remove the [i]-th process from the head of [q] and return it */
+struct pcb_t * queue_remove_at(struct queue_t * q, int i);
+
+/* Remove [proc] from [q]. Return 0 if it was found, 1 otherwise */
+int queue_remove(struct queue_t * q, struct pcb_t * proc);
+
+/* Release the ring buffer of [q], leaving it an empty queue */
+void queue_free(struct queue_t * q);
+
 #endif
 
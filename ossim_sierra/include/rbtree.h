@@ -0,0 +1,42 @@
+#ifndef RBTREE_H
+#define RBTREE_H
+
+#include <stddef.h>
+
+/* Intrusive red-black tree, embed a struct rb_node in the keyed object
+ * and get the object back with rb_entry() */
+struct rb_node {
+	struct rb_node * parent;
+	struct rb_node * left;
+	struct rb_node * right;
+	int red;
+};
+
+struct rb_root {
+	struct rb_node * node;
+};
+
+#define RB_ROOT (struct rb_root) { NULL }
+
+#define rb_entry(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+/* Mark [node] as linked in no tree, for RB_EMPTY_NODE() */
+#define RB_CLEAR_NODE(node)	((node)->parent = (node))
+#define RB_EMPTY_NODE(node)	((node)->parent == (node))
+
+/* Rebalance after linking [node] as a leaf below [parent] at [*link] */
+void rb_link_node(struct rb_node * node, struct rb_node * parent,
+		struct rb_node ** link);
+void rb_insert_color(struct rb_node * node, struct rb_root * root);
+
+void rb_erase(struct rb_node * node, struct rb_root * root);
+
+/* Leftmost (smallest) node of the tree, NULL if empty */
+struct rb_node * rb_first(const struct rb_root * root);
+
+/* In-order successor of [node], NULL if it is the last one */
+struct rb_node * rb_next(const struct rb_node * node);
+
+#endif
+
@@ -1,5 +1,5 @@
-#ifndef QUEUE_H
-#define QUEUE_H
+#ifndef SCHED_H
+#define SCHED_H
 
 #include "common.h"
 
@@ -9,20 +9,67 @@
 
 #define MAX_PRIO 140
 
+/* Run queue layout of the MLQ policy, selected by the "rq" option of
+ * the config file */
+enum rq_mode_t {
+	RQ_GLOBAL,	// One run queue shared by all CPUs
+	RQ_PERCPU,	// One run queue per CPU, idle CPUs steal work
+};
+
+/* Scheduling policy, selected by the "sched" option of the config file.
+ * The policy owns its ready queues and their locking */
+struct sched_ops_t {
+	const char * name;
+	void (*init)(int num_cpus, enum rq_mode_t mode);
+	void (*finish)(void);
+	/* Next process to run on CPU [cpu], NULL if there is none */
+	struct pcb_t * (*get)(int cpu);
+	/* Requeue a process preempted on CPU [cpu] */
+	void (*put)(struct pcb_t * proc, int cpu);
+	/* Queue a newly admitted process */
+	void (*add)(struct pcb_t * proc);
+	/* Take [proc] out of the ready queues. Return 0 if it was queued,
+	 * 1 if it is not (it runs on a CPU) */
+	int (*remove)(struct pcb_t * proc);
+	/* Account [slots] time slots of [proc] running on CPU [cpu], may
+	 * be NULL */
+	void (*tick)(struct pcb_t * proc, int cpu, int slots);
+};
+
+extern const struct sched_ops_t mlq_sched_ops;
+extern const struct sched_ops_t fifo_sched_ops;
+extern const struct sched_ops_t cfs_sched_ops;
+
+/* Look up a policy by name, NULL if there is no such policy */
+const struct sched_ops_t * find_sched_ops(const char * name);
+
 int queue_empty(void);
 
-void init_scheduler(void);
+void init_scheduler(const struct sched_ops_t * ops,
+		int num_cpus, enum rq_mode_t mode);
 void finish_scheduler(void);
 
-/* Get the next process from ready queue */
-struct pcb_t * get_proc(void);
+/* Get the next process from ready queue of CPU [cpu] */
+struct pcb_t * get_proc(int cpu);
 
-/* Put a process back to run queue */
-void put_proc(struct pcb_t * proc);
+/* Put a process back to run queue of CPU [cpu] */
+void put_proc(struct pcb_t * proc, int cpu);
 
-/* Add a new process to ready queue */
+/* Add a new process to ready queue. Lock-free, the process reaches the
+ * policy when a CPU next calls get_proc() */
 void add_proc(struct pcb_t * proc);
 
+/* Account [slots] time slots of [proc] running on CPU [cpu] */
+void sched_tick(struct pcb_t * proc, int cpu, int slots);
+
+/* Forget a process which has finished its job */
+void finish_proc(struct pcb_t * proc);
+
+/* Take the queued process [pid] out of the ready queues and delist it,
+ * the caller then owns it. NULL if there is no such process or if it
+ * runs on a CPU */
+struct pcb_t * remove_proc(uint32_t pid);
+
 #endif
 
 
@@ -0,0 +1,29 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "common.h"
+
+/* Per-process latency accounting. The scheduler stamps the PCB times
+ * (in time slots) and hands a finished process to stats_record(), the
+ * collected figures are written by stats_dump() at shutdown */
+
+void stats_init(void);
+
+/* Save the latency figures of a finished process */
+void stats_record(struct pcb_t * proc);
+
+/* Write per-process and aggregate wait, response and turnaround
+ * statistics as JSON to [path]. Return 0 on success */
+int stats_dump(const char * path);
+
+/* Print the performance counters of [proc], finishing on [cpu] */
+void stats_print_perf(int cpu, struct pcb_t * proc);
+
+/* Print the performance counters of every finished process as a table,
+ * with their totals */
+void stats_perf_table(void);
+
+void stats_finish(void);
+
+#endif
+
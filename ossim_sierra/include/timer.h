@@ -5,12 +5,16 @@
 #include <stdint.h>
 
 struct timer_id_t {
-	int done;
 	int fsh;
-	pthread_cond_t event_cond;
-	pthread_mutex_t event_lock;
-	pthread_cond_t timer_cond;
-	pthread_mutex_t timer_lock;
+	int parked;		// Idle in park_slot(), out of the slot barrier
+	int asleep;		// Idle in sleep_until(), out of the slot barrier
+	int away;		// Between leave_until() and rejoin_slot()
+	uint32_t wait_sense;	// Barrier sense of the slot to resume after
+	unsigned long wake_seen;	// wake_parked() generation seen at slot start
+				// or wait_turn()
+	uint64_t wake_time;	// Time sleep_until() resumes at
+	int rank;		// Order of the device in wait_turn()
+	uint32_t done_sense;	// Barrier sense of the last slot arrived at
 };
 
 void start_timer();
@@ -23,6 +27,48 @@ void detach_event(struct timer_id_t * event);
 
 void next_slot(struct timer_id_t* timer_id);
 
+/* Finish the current slot like next_slot() and every slot after it
+ * until the time reaches [time]. When every other device is parked or
+ * asleep too, the timer jumps straight to the earliest wake up */
+void sleep_until(struct timer_id_t* timer_id, uint64_t time);
+
+/* sleep_until() in two halves, for a device which keeps working on
+ * private state while out of the barrier. leave_until() finishes the
+ * current slot and every slot before [time] without waiting, the
+ * device then does the work of those slots and rejoin_slot() waits for
+ * [time]. With [time] right after the current slot, the pair is a
+ * plain next_slot() */
+void leave_until(struct timer_id_t* timer_id, uint64_t time);
+
+void rejoin_slot(struct timer_id_t* timer_id);
+
+/* Finish the current slot like next_slot(), then stay parked until
+ * wake_parked() is called. The timer does not wait for a parked device,
+ * it resumes in the slot following the wake up. A wake up earlier in
+ * the current slot, after the wait_turn() of the device, counts too:
+ * the device then polls the next slot */
+void park_slot(struct timer_id_t* timer_id);
+
+/* Wake up every parked device */
+void wake_parked();
+
+/* Number of wake_parked() calls so far */
+unsigned long wake_count();
+
+/* Block until every device attached before this one is through with
+ * the current slot: it has arrived at the barrier, or it is parked,
+ * asleep or detached. A device calls it before work that must happen
+ * in attach order, the CPUs do in the ordered mode of os.c */
+void wait_turn(struct timer_id_t* timer_id);
+
 uint64_t current_time();
 
+/* Log the "Time slot" line of the current slot */
+void print_slot();
+
+/* Clock of the single-threaded engine, which runs without the timer
+ * thread: end the current slot and move on to [time], at least one slot
+ * later, logging the slots skipped on the way */
+void advance_time(uint64_t time);
+
 #endif
@@ -0,0 +1,65 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* The text output of the simulation. Every thread formats its records
+ * into a buffer of its own, without taking any lock, and a writer thread
+ * prints them in timeline order: by time slot, then by source, then in
+ * the order each thread made them. Within a slot the timer comes first,
+ * then the loader, then the CPUs by id, as the single-threaded engine
+ * runs them. Without the writer, records are printed right away */
+
+enum trace_source_t {
+	TRACE_TIMER = 0,
+	TRACE_LOADER = 1,
+	TRACE_CPU = 2,		/* CPU i logs as TRACE_CPU + i */
+	TRACE_OTHER = 1 << 30	/* Threads which did not attach */
+};
+
+/* Output categories. A category which is off costs its call sites one
+ * test of [trace_mask] */
+enum trace_cat_t {
+	TRACE_SCHED = 1 << 0,	/* Time slots, loads, dispatches */
+	TRACE_IO = 1 << 1,	/* Memory operation banners */
+	TRACE_PGTBL = 1 << 2,	/* Page tables in the banners */
+	TRACE_MEMDUMP = 1 << 3,	/* Physical memory in the banners */
+	TRACE_MEMIO = 1 << 4,	/* Physical stores */
+	TRACE_SYSCALL = 1 << 5,	/* Output of the system calls */
+	TRACE_ALL = (1 << 6) - 1
+};
+
+/* Enabled categories, every one by default */
+extern unsigned int trace_mask;
+
+#define TRACE_ON(cat) (trace_mask & (cat))
+
+/* Set [trace_mask] from [spec]: a level from 0 (nothing) to 3 (every
+ * category), or a comma separated list of category names. The list
+ * replaces the enabled categories, unless its first name starts with
+ * '+' or '-': the names then add to or remove from them, as in
+ * "-memdump,-pgtbl". Return 0 on success */
+int trace_parse(const char * spec);
+
+/* Start the writer thread */
+void trace_start(void);
+
+/* Print every pending record and stop the writer */
+void trace_stop(void);
+
+/* Log the records of the calling thread as [source] */
+void trace_attach(int source);
+
+/* Add a record at the current time slot */
+void trace_printf(const char * fmt, ...)
+	__attribute__((format(printf, 1, 2)));
+
+/* Add a binary record of [len] bytes, ordered with the text but written
+ * to the file set by trace_bin_file() */
+void trace_write(const void * data, uint32_t len);
+
+/* Write the binary records to [file], drop them when it is NULL */
+void trace_bin_file(FILE * file);
+
+#endif
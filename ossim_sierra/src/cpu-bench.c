@@ -0,0 +1,256 @@
+/* Interpreter micro-benchmark: instructions per second of run() on the
+ * pre-decoded ops against the former switch interpreter on the raw text.
+ *
+ *	cpu-bench [program] [rounds]
+ *
+ * Without a program, a synthetic stream is used: a region is allocated,
+ * then CALC instructions alternate with writes and reads of it, and the
+ * region is freed. A program may use CALC, ALLOC, FREE, READ and WRITE:
+ * system calls and the bulk memory instructions act on the rest of the
+ * simulation. Every round runs in a fresh address space of the same
+ * paged memory.
+ */
+
+#include "cpu.h"
+#include "loader.h"
+#include "mm.h"
+#include "libmem.h"
+#include "syscall.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+int calc(struct pcb_t *proc);
+
+#define BENCH_SIZE	4096
+#define BENCH_ROUNDS	2000
+#define BENCH_REGION	1024	/* Bytes of the synthetic region */
+#define BENCH_RAMSZ	0x100000
+#define BENCH_SWPSZ	0x1000000
+
+/* The interpreter run() replaced, kept as the reference. It keeps the
+ * performance counters run() keeps, so only the dispatch differs */
+static __attribute__((noinline)) int run_switch(struct pcb_t *proc)
+{
+	if (proc->pc >= proc->code->size)
+	{
+		return 1;
+	}
+
+	struct inst_t ins = proc->code->text[proc->pc];
+	proc->pc++;
+	proc->perf.instructions++;
+	int stat = 1;
+	switch (ins.opcode)
+	{
+	case CALC:
+		stat = calc(proc);
+		break;
+	case ALLOC:
+		proc->perf.nr_alloc++;
+		stat = liballoc(proc, ins.arg_0, ins.arg_1);
+		break;
+	case FREE:
+		proc->perf.nr_free++;
+		stat = libfree(proc, ins.arg_0);
+		break;
+	case READ:
+		stat = libread(proc, ins.arg_0, ins.arg_1, &ins.arg_2);
+		break;
+	case WRITE:
+		stat = libwrite(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+		break;
+	case SYSCALL:
+		stat = libsyscall(proc, ins.arg_0, ins.arg_1, ins.arg_2, ins.arg_3);
+		break;
+	default:
+		stat = 1;
+	}
+	return stat;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Free the regions a round of the program left allocated, then its
+ * address space, so that every round starts from the same memory */
+static void release(struct pcb_t *proc)
+{
+	struct mm_struct *mm = proc->mm;
+	struct vm_area_struct *vma;
+	struct vm_rg_struct *rg;
+	struct pgn_t *pg;
+	int i;
+
+	for (i = 0; i < PAGING_MAX_SYMTBL_SZ; i++)
+		if (mm->symrgtbl[i].rg_end > mm->symrgtbl[i].rg_start)
+			libfree(proc, i);
+
+	while ((vma = mm->mmap) != NULL)
+	{
+		while ((rg = vma->vm_freerg_list) != NULL)
+		{
+			vma->vm_freerg_list = rg->rg_next;
+			free(rg);
+		}
+		mm->mmap = vma->vm_next;
+		free(vma);
+	}
+	while ((pg = mm->fifo_pgn) != NULL)
+	{
+		mm->fifo_pgn = pg->pg_next;
+		free(pg);
+	}
+	free(mm->pgd);
+	free(mm);
+}
+
+/* Seconds of one run of the code by [interp] */
+static double run_round(int (*interp)(struct pcb_t *), struct pcb_t *proc)
+{
+	double start;
+
+	proc->pc = 0;
+	proc->mm = calloc(1, sizeof(struct mm_struct));
+	init_mm(proc->mm, proc);
+	start = now();
+	while (interp(proc) == 0)
+		;
+	start = now() - start;
+	release(proc);
+	return start;
+}
+
+/* Instructions per second of [interps] over [rounds] runs of the code
+ * each, counted by the retired instructions: a failed instruction ends
+ * its round early. The interpreters take turns round by round, so that
+ * a drift in the speed of the machine weighs on all of them alike */
+static void bench(int (*interps[])(struct pcb_t *), int n,
+		struct pcb_t *proc, long rounds, double ips[])
+{
+	uint64_t retired[n];
+	double elapsed[n];
+	uint64_t before;
+	long r;
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		retired[i] = 0;
+		elapsed[i] = 0;
+	}
+	for (r = 0; r < rounds; r++)
+	{
+		for (i = 0; i < n; i++)
+		{
+			before = proc->perf.instructions;
+			elapsed[i] += run_round(interps[i], proc);
+			retired[i] += proc->perf.instructions - before;
+		}
+	}
+	for (i = 0; i < n; i++)
+		ips[i] = retired[i] / elapsed[i];
+}
+
+static struct pcb_t *synthetic(uint32_t size)
+{
+	struct pcb_t *proc = calloc(1, sizeof(struct pcb_t));
+	struct inst_t *ins;
+	uint32_t i;
+
+	proc->code = malloc(sizeof(struct code_seg_t));
+	proc->code->size = size;
+	proc->code->text = calloc(size, sizeof(struct inst_t));
+	ins = proc->code->text;
+
+	ins[0].opcode = ALLOC;
+	ins[0].arg_0 = BENCH_REGION;
+	ins[0].arg_1 = 0;
+	for (i = 1; i + 1 < size; i++)
+	{
+		/* Half CALC, a quarter writes and a quarter reads, over the
+		 * whole region */
+		switch (i % 4)
+		{
+		case 1:
+			ins[i].opcode = WRITE;
+			ins[i].arg_0 = i & 0xff;
+			ins[i].arg_1 = 0;
+			ins[i].arg_2 = i % BENCH_REGION;
+			break;
+		case 3:
+			ins[i].opcode = READ;
+			ins[i].arg_0 = 0;
+			ins[i].arg_1 = (i - 2) % BENCH_REGION;
+			ins[i].arg_2 = 1;
+			break;
+		default:
+			ins[i].opcode = CALC;
+		}
+	}
+	ins[size - 1].opcode = FREE;
+	ins[size - 1].arg_0 = 0;
+	decode(proc->code);
+	return proc;
+}
+
+int main(int argc, char *argv[])
+{
+	struct memphy_struct mram;
+	struct memphy_struct mswp[PAGING_MAX_MMSWP];
+	struct pcb_t *proc;
+	long rounds = BENCH_ROUNDS;
+	int (*interps[])(struct pcb_t *) = { run_switch, run };
+	double ips[2];
+	uint32_t i;
+	int sit;
+
+	if (argc > 3)
+	{
+		printf("Usage: cpu-bench [program] [rounds]\n");
+		return 1;
+	}
+	proc = (argc > 1) ? load(argv[1]) : synthetic(BENCH_SIZE);
+	if (argc > 2)
+		rounds = atol(argv[2]);
+
+	for (i = 0; i < proc->code->size; i++)
+	{
+		if (proc->code->text[i].opcode > WRITE)
+		{
+			printf("cpu-bench: only CALC, ALLOC, FREE, READ and "
+				"WRITE programs can be replayed\n");
+			return 1;
+		}
+	}
+
+	/* The memory of the simulation, as os sets it up by default, without
+	 * the banners of the memory operations */
+	init_memphy(&mram, BENCH_RAMSZ, 1);
+	mram.id = 0;
+	for (sit = 0; sit < PAGING_MAX_MMSWP; sit++)
+	{
+		init_memphy(&mswp[sit], sit ? 0 : BENCH_SWPSZ, 1);
+		mswp[sit].id = sit + 1;
+	}
+	proc->mram = &mram;
+	proc->mswp = (struct memphy_struct **)&mswp;
+	proc->active_mswp = &mswp[0];
+	trace_mask = 0;
+
+	bench(interps, 2, proc, rounds / 10 + 1, ips);	/* Warm up */
+	bench(interps, 2, proc, rounds, ips);
+
+	printf("instructions: %u x %ld rounds\n", proc->code->size, rounds);
+	printf("switch:   %8.2f Minst/s\n", ips[0] / 1e6);
+	printf("threaded: %8.2f Minst/s\n", ips[1] / 1e6);
+	printf("speedup:  %8.2fx\n", ips[1] / ips[0]);
+	return 0;
+}
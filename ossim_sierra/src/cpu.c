@@ -4,6 +4,9 @@
 #include "mm.h"
 #include "syscall.h"
 #include "libmem.h"
+#include "event.h"
+
+#include <stdlib.h>
 
 int calc(struct pcb_t *proc)
 {
@@ -58,55 +61,207 @@ int write(
 	return write_mem(proc->regs[destination] + offset, proc, data);
 }
 
+/* Bulk memory instructions on [source] + [offset] spans, one byte at a
+ * time: the flat memory has no page walk to amortise */
+int set_data(struct pcb_t *proc, uint32_t destination, uint32_t offset,
+	BYTE data, uint32_t size)
+{
+	uint32_t i;
+
+	for (i = 0; i < size; i++)
+		if (write_mem(proc->regs[destination] + offset + i, proc, data))
+			return 1;
+	return 0;
+}
+
+int copy_data(struct pcb_t *proc, uint32_t destination, uint32_t dst_off,
+	uint32_t source, uint32_t src_off, uint32_t size)
+{
+	addr_t dst = proc->regs[destination] + dst_off;
+	addr_t src = proc->regs[source] + src_off;
+	uint32_t i, j;
+	BYTE data;
+
+	/* Copy from the end when the destination overlaps the source tail */
+	for (i = 0; i < size; i++)
+	{
+		j = (dst > src && dst < src + size) ? size - 1 - i : i;
+		if (read_mem(src + j, proc, &data) || write_mem(dst + j, proc, data))
+			return 1;
+	}
+	return 0;
+}
+
+/* The sign of the first differing byte, as memcmp(), goes to register
+ * [destination] */
+int cmp_data(struct pcb_t *proc, uint32_t first, uint32_t first_off,
+	uint32_t second, uint32_t second_off, uint32_t size,
+	uint32_t destination)
+{
+	uint32_t i;
+	BYTE a, b;
+
+	for (i = 0; i < size; i++)
+	{
+		if (read_mem(proc->regs[first] + first_off + i, proc, &a) ||
+			read_mem(proc->regs[second] + second_off + i, proc, &b))
+			return 1;
+		if (a != b)
+			break;
+	}
+	proc->regs[destination] = (i == size) ? 0 :
+		((unsigned char)a > (unsigned char)b) ? 1 : -1;
+	return 0;
+}
+
+/* Handlers of run(), indexed by opcode, for decode() */
+static const void *const *op_handlers;
+
 int run(struct pcb_t *proc)
 {
+	/* The handlers are labels of this function, dispatched to through
+	 * computed goto on the address decode() stored in each op_t. Label
+	 * addresses are only in scope in their own function: run(NULL)
+	 * hands them over to decode() */
+	static const void *const handlers[] = {
+		[CALC] = &&do_calc,
+		[ALLOC] = &&do_alloc,
+		[FREE] = &&do_free,
+		[READ] = &&do_read,
+		[WRITE] = &&do_write,
+		[SYSCALL] = &&do_syscall,
+		[MEMSET] = &&do_memset,
+		[MEMCPY] = &&do_memcpy,
+		[MEMCMP] = &&do_memcmp,
+		[MEMCMP + 1] = &&do_invalid,
+	};
+	const struct op_t *op;
+
+	if (proc == NULL)
+	{
+		op_handlers = handlers;
+		return 0;
+	}
+
 	/* Check if Program Counter point to the proper instruction */
 	if (proc->pc >= proc->code->size)
 	{
 		return 1;
 	}
 
-	struct inst_t ins = proc->code->text[proc->pc];
+	op = &proc->code->ops[proc->pc];
 	proc->pc++;
-	int stat = 1;
-switch (ins.opcode)
+	proc->perf.instructions++;
+	goto *op->handler;
+
+do_calc:
+	return calc(proc);
+do_alloc:
+	proc->perf.nr_alloc++;
+#ifdef MM_PAGING
+	return liballoc(proc, op->arg_0, op->arg_1);
+#else
+	return alloc(proc, op->arg_0, op->arg_1);
+#endif
+do_free:
+	proc->perf.nr_free++;
+#ifdef MM_PAGING
+	return libfree(proc, op->arg_0);
+#else
+	return free_data(proc, op->arg_0);
+#endif
+do_read:
+#ifdef MM_PAGING
 	{
-	case CALC:
-		stat = calc(proc);
-		break;
-	case ALLOC:
+		uint32_t destination = op->arg_2;
+		return libread(proc, op->arg_0, op->arg_1, &destination);
+	}
+#else
+	return read(proc, op->arg_0, op->arg_1, op->arg_2);
+#endif
+do_write:
 #ifdef MM_PAGING
-		stat = liballoc(proc, ins.arg_0, ins.arg_1);
+	return libwrite(proc, op->arg_0, op->arg_1, op->arg_2);
 #else
-		stat = alloc(proc, ins.arg_0, ins.arg_1);
+	return write(proc, op->arg_0, op->arg_1, op->arg_2);
 #endif
-		break;
-	case FREE:
+do_syscall:
+	if (event_on)
+		EVENT(EV_SYSCALL, proc->pid, op->arg_0, op->arg_1, op->arg_2,
+			op->arg_3);
+	return libsyscall(proc, op->arg_0, op->arg_1, op->arg_2, op->arg_3);
+do_memset:
 #ifdef MM_PAGING
-		stat = libfree(proc, ins.arg_0);
+	return libmemset(proc, op->arg_0, op->arg_1, op->arg_2, op->arg_3);
 #else
-		stat = free_data(proc, ins.arg_0);
+	return set_data(proc, op->arg_0, op->arg_1, op->arg_2, op->arg_3);
 #endif
-		break;
-	case READ:
+do_memcpy:
 #ifdef MM_PAGING
-		stat = libread(proc, ins.arg_0, ins.arg_1, &ins.arg_2);
+	return libmemcpy(proc, op->arg_0, op->arg_1, op->arg_2, op->arg_3,
+		op->arg_4);
 #else
-		stat = read(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+	return copy_data(proc, op->arg_0, op->arg_1, op->arg_2, op->arg_3,
+		op->arg_4);
 #endif
-		break;
-	case WRITE:
+do_memcmp:
 #ifdef MM_PAGING
-		stat = libwrite(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+	{
+		int result;
+		int val = libmemcmp(proc, op->arg_0, op->arg_1, op->arg_2,
+			op->arg_3, op->arg_4, &result);
+		if (val == 0)
+			proc->regs[op->arg_5] = result;
+		return val;
+	}
 #else
-		stat = write(proc, ins.arg_0, ins.arg_1, ins.arg_2);
+	return cmp_data(proc, op->arg_0, op->arg_1, op->arg_2, op->arg_3,
+		op->arg_4, op->arg_5);
 #endif
-		break;
-	case SYSCALL:
-		stat = libsyscall(proc, ins.arg_0, ins.arg_1, ins.arg_2, ins.arg_3);
-		break;
-	default:
-		stat = 1;
+do_invalid:
+	return 1;
+}
+
+void decode(struct code_seg_t *code)
+{
+	uint32_t i;
+
+	if (op_handlers == NULL)
+		run(NULL);
+
+	code->ops = (struct op_t *)malloc(sizeof(struct op_t) * code->size);
+	for (i = code->size; i-- > 0;)
+	{
+		struct inst_t *ins = &code->text[i];
+		struct op_t *op = &code->ops[i];
+
+		op->handler = op_handlers[(ins->opcode <= MEMCMP) ?
+			ins->opcode : MEMCMP + 1];
+		op->arg_0 = ins->arg_0;
+		op->arg_1 = ins->arg_1;
+		op->arg_2 = ins->arg_2;
+		op->arg_3 = ins->arg_3;
+		op->arg_4 = ins->arg_4;
+		op->arg_5 = ins->arg_5;
+		if (ins->opcode != CALC)
+			op->calc_run = 0;
+		else if (i + 1 < code->size)
+			op->calc_run = code->ops[i + 1].calc_run + 1;
+		else
+			op->calc_run = 1;
 	}
-	return stat;
+}
+
+uint32_t calc_ahead(struct pcb_t *proc)
+{
+	if (proc->pc >= proc->code->size)
+		return 0;
+	return proc->code->ops[proc->pc].calc_run;
+}
+
+void run_calc(struct pcb_t *proc, uint32_t n)
+{
+	/* calc() has no effect, the batch only moves the program counter */
+	proc->pc += n;
+	proc->perf.instructions += n;
 }
@@ -0,0 +1,73 @@
+
+#include "event.h"
+#include "timer.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int event_on = 0;
+
+static FILE * event_file = NULL;
+
+_Static_assert(sizeof(struct event_t) == 40, "event_t layout changed");
+
+int event_open(const char * path)
+{
+	struct event_hdr_t hdr = {EVENT_MAGIC, EVENT_VERSION,
+		sizeof(struct event_t)};
+
+	if ((event_file = fopen(path, "wb")) == NULL)
+		return -1;
+	fwrite(&hdr, sizeof(hdr), 1, event_file);
+	trace_bin_file(event_file);
+	event_on = 1;
+	return 0;
+}
+
+void event_close(void)
+{
+	if (event_file == NULL)
+		return;
+	event_on = 0;
+	trace_bin_file(NULL);
+	fclose(event_file);
+	event_file = NULL;
+}
+
+void event_emit(int type, uint32_t pid, const int32_t * arg,
+		const void * data, uint32_t len)
+{
+	uint32_t more = (len + sizeof(arg[0]) * EVENT_NARGS - 1) /
+		(sizeof(arg[0]) * EVENT_NARGS);
+	struct event_t ev, * evs;
+	uint32_t i;
+
+	ev.time = current_time();
+	ev.type = type;
+	ev.more = more;
+	ev.pid = pid;
+	memcpy(ev.arg, arg, sizeof(ev.arg));
+	if (more == 0)
+	{
+		trace_write(&ev, sizeof(ev));
+		return;
+	}
+
+	/* One record for the whole group, so that it stays in one piece */
+	if ((evs = calloc(more + 1, sizeof(ev))) == NULL)
+		return;
+	evs[0] = ev;
+	for (i = 1; i <= more; i++)
+	{
+		evs[i].time = ev.time;
+		evs[i].type = EV_DATA;
+		evs[i].pid = pid;
+	}
+	for (i = 0; i < len; i += sizeof(ev.arg))
+		memcpy(evs[1 + i / sizeof(ev.arg)].arg, (const char *)data + i,
+			(len - i < sizeof(ev.arg)) ? len - i : sizeof(ev.arg));
+	trace_write(evs, (more + 1) * sizeof(ev));
+	free(evs);
+}
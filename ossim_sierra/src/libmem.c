@@ -18,6 +18,8 @@
 #include "mm.h"
 #include "syscall.h"
 #include "libmem.h"
+#include "trace.h"
+#include "event.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <pthread.h>
@@ -58,6 +60,67 @@ struct vm_rg_struct *get_symrg_byid(struct mm_struct *mm, int rgid)
   return &mm->symrgtbl[rgid];
 }
 
+/*map_rg_pages - map a frame to every page of [rg_start, rg_end) that
+ *__free() has released
+ */
+static int map_rg_pages(struct pcb_t *caller, int rg_start, int rg_end)
+{
+  struct framephy_struct *frm;
+  struct vm_rg_struct ret_rg;
+  int pgn;
+
+  for (pgn = PAGING_PGN(rg_start); pgn <= PAGING_PGN((rg_end - 1)); pgn++)
+  {
+    if (caller->mm->pgd[pgn] != 0)
+      continue;
+
+    frm = NULL;
+    if (alloc_pages_range(caller, 1, &frm) != 0 || frm == NULL)
+      return -1;
+    vmap_page_range(caller, pgn * PAGING_PAGESZ, 1, frm, &ret_rg);
+    free(frm);
+  }
+
+  return 0;
+}
+
+/*pg_in_use - page [pgn] holds bytes of an allocated region */
+static int pg_in_use(struct mm_struct *mm, int pgn)
+{
+  int rgid;
+
+  for (rgid = 0; rgid < PAGING_MAX_SYMTBL_SZ; rgid++)
+    if (OVERLAP(mm->symrgtbl[rgid].rg_start, mm->symrgtbl[rgid].rg_end,
+                pgn * PAGING_PAGESZ, (pgn + 1) * PAGING_PAGESZ))
+      return 1;
+
+  return 0;
+}
+
+/*pg_release - unmap page [pgn] and give its frame back */
+static void pg_release(struct pcb_t *caller, int pgn)
+{
+  uint32_t pte = caller->mm->pgd[pgn];
+  int fpn;
+
+  if (pte & PAGING_PTE_SWAPPED_MASK)
+    MEMPHY_put_freefp(caller->active_mswp, PAGING_PTE_SWP(pte));
+  else if (PAGING_PAGE_PRESENT(pte))
+  {
+    /* The next owner of the frame must not see the freed bytes */
+    fpn = PAGING_PTE_FPN(pte);
+    MEMPHY_fill(caller->mram, fpn * PAGING_PAGESZ, 0, PAGING_PAGESZ);
+    if (event_on)
+      EVENT(EV_FILL, caller->pid, fpn * PAGING_PAGESZ, 0, PAGING_PAGESZ);
+    MEMPHY_put_freefp(caller->mram, fpn);
+  }
+  else
+    return;
+
+  caller->mm->pgd[pgn] = 0;
+  delist_pgn_node(&caller->mm->fifo_pgn, pgn);
+}
+
 /*__alloc - allocate a region memory
  *@caller: caller
  *@vmaid: ID vm area to alloc memory region
@@ -79,6 +142,11 @@ int __alloc(struct pcb_t *caller, int vmaid, int rgid, int size, int *alloc_addr
 
   if (get_free_vmrg_area(caller, vmaid, size, &rgnode) == 0)
   {
+    if (map_rg_pages(caller, rgnode.rg_start, rgnode.rg_end) != 0)
+    {
+      pthread_mutex_unlock(&mmvm_lock);
+      return -1;
+    }
     caller->mm->symrgtbl[rgid].rg_start = rgnode.rg_start;
     caller->mm->symrgtbl[rgid].rg_end = rgnode.rg_end;
  
@@ -117,23 +185,16 @@ int __alloc(struct pcb_t *caller, int vmaid, int rgid, int size, int *alloc_addr
   int inc_limit_ret = inc_vma_limit(caller, vmaid, size);
   if(inc_limit_ret < 0) {
     pthread_mutex_unlock(&mmvm_lock);
-    printf("inc_vma_limit failed\0");
+    trace_printf("inc_vma_limit failed\0");
     return -1;
   }
   /* TODO: commit the limit increment */
-  cur_vma = get_vma_by_num(caller->mm, vmaid);
-  newrg->rg_start = cur_vma->vm_start;
-  newrg->rg_end = cur_vma->vm_end;
-  newrg->rg_next = NULL;
-  cur_vma = get_vma_by_num(caller->mm, vmaid);
-  if(enlist_vm_freerg_list(caller->mm, newrg) != 0)
-  {
-    pthread_mutex_unlock(&mmvm_lock);
-    return -1;
-  }
+  /* inc_vma_limit() has enlisted the new area as a free region already */
+  free(newrg);
   /* TODO: commit the allocation address */
 
-  if(get_free_vmrg_area(caller, vmaid, size, &rgnode) != 0)
+  if(get_free_vmrg_area(caller, vmaid, size, &rgnode) != 0 ||
+     map_rg_pages(caller, rgnode.rg_start, rgnode.rg_end) != 0)
   {
     pthread_mutex_unlock(&mmvm_lock);
     return -1;
@@ -157,52 +218,17 @@ int __free(struct pcb_t *caller, int vmaid, int rgid)
 {
   struct vm_rg_struct *rgnode;
 
-  struct sc_regs *regs;
-
-  // Dummy initialization for avoding compiler dummay warning
-  // in incompleted TODO code rgnode will overwrite through implementing
-  // the manipulation of rgid later
-
   if(rgid < 0 || rgid > PAGING_MAX_SYMTBL_SZ)
     return -1;
 
   /* TODO: Manage the collect freed region to freerg_list */
+  pthread_mutex_lock(&mmvm_lock);
 
   rgnode = get_symrg_byid(caller->mm, rgid);
 
   unsigned long rg_start = rgnode->rg_start;
   unsigned long rg_end = rgnode->rg_end;
 
-  int pg_start = PAGING_PGN(rg_start);
-  int pg_end = PAGING_PGN((rg_end - 1));
-
-  /*enlist the obsoleted memory region */
-  for(int i = pg_start; i < pg_end; i++) {
-    uint32_t pte = caller->mm->pgd[i];
-
-    if(!PAGING_PAGE_PRESENT(pte)) {
-      //printf("Page %d is not present\n", i);
-      continue;
-    }
-
-    int fpn = PAGING_PTE_FPN(pte);
-
-    int pg_free_start = (i == pg_start) ? PAGING_OFFST(rg_start) : 0;
-    int pg_free_end = PAGING_PAGESZ;
-
-    for(int offset = pg_free_start; offset < pg_free_end; offset++) {
-      int phyaddr = fpn * PAGE_SIZE + offset;
-      
-      regs->a1 = SYSMEM_IO_WRITE;
-      regs->a2 = phyaddr;
-      regs->a3 = 0; // write 0 to free the page
-      syscall(caller, 17, regs);
-    }
-
-    caller->mm->pgd[i] = 0;
-    MEMPHY_put_freefp(caller->mram, fpn);
-  }
-
   struct vm_rg_struct *freedrg = malloc(sizeof(struct vm_rg_struct));
   if(freedrg) {
     freedrg->rg_start = rg_start;
@@ -211,6 +237,7 @@ int __free(struct pcb_t *caller, int vmaid, int rgid)
 
     if(enlist_vm_freerg_list(caller->mm, freedrg) != 0) {
       free(freedrg);
+      pthread_mutex_unlock(&mmvm_lock);
       return -1;
     }
   }
@@ -219,9 +246,187 @@ int __free(struct pcb_t *caller, int vmaid, int rgid)
   rgnode->rg_end = 0;
   rgnode->rg_next = NULL;
 
+  /* Regions are not page aligned, a neighbour region may still live in
+   * the first or the last page of this one */
+  if (rg_end > rg_start)
+    for (int pgn = PAGING_PGN(rg_start); pgn <= PAGING_PGN((rg_end - 1)); pgn++)
+      if (!pg_in_use(caller->mm, pgn))
+        pg_release(caller, pgn);
+
+  pthread_mutex_unlock(&mmvm_lock);
   return 0;
 }
 
+/*iodump_event - record a memory operation banner as one event, carrying
+ *the page table print_pgtbl() would print
+ *@proc: Process executing the instruction
+ *@type: event type
+ *@arg: event arguments, the last one is set to [dump]
+ *@dump: the banner has a MEMPHY_dump()
+ */
+static void iodump_event(struct pcb_t *proc, int type, int32_t *arg, int dump)
+{
+  struct vm_area_struct *vma;
+  uint32_t npg, *tbl;
+
+  arg[EVENT_NARGS - 1] = dump && TRACE_ON(TRACE_MEMDUMP);
+  if (!TRACE_ON(TRACE_PGTBL))
+  {
+    event_emit(type, proc->pid, arg, NULL, 0);
+    return;
+  }
+
+  vma = get_vma_by_num(proc->mm, 0);
+  npg = PAGING_PGN(vma->vm_end);
+  if ((tbl = malloc((npg + 1) * sizeof(uint32_t))) == NULL)
+    return;
+  tbl[0] = vma->vm_end;
+  memcpy(tbl + 1, proc->mm->pgd, npg * sizeof(uint32_t));
+  event_emit(type, proc->pid, arg, tbl, (npg + 1) * sizeof(uint32_t));
+  free(tbl);
+}
+
+/*iodump_end - end of a memory operation banner: the page table, the
+ *physical memory when [dump], then the closing rule
+ */
+static void iodump_end(struct pcb_t *proc, int dump)
+{
+  if (TRACE_ON(TRACE_PGTBL))
+    print_pgtbl(proc, 0, -1); //print max TBL
+  if (dump && TRACE_ON(TRACE_MEMDUMP))
+    MEMPHY_dump(proc->mram);
+  trace_printf("================================================================\n");
+}
+
+/* The banner of each memory operation, as an event while the trace file
+ * is open, else as text */
+
+static void iodump_alloc(struct pcb_t *proc, uint32_t reg_index, int addr,
+                         uint32_t size)
+{
+  if (TRACE_ON(TRACE_IO) && event_on)
+  {
+    int32_t arg[EVENT_NARGS] = {reg_index, addr, size};
+    iodump_event(proc, EV_ALLOC, arg, 0);
+  }
+  else if (TRACE_ON(TRACE_IO))
+  {
+    trace_printf("===== PHYSICAL MEMORY AFTER ALLOCATION =====\n");
+    trace_printf("PID=%d - Region=%d - Address=%08x - Size=%d byte\n", proc->pid, reg_index, addr, size);
+    if (TRACE_ON(TRACE_PGTBL))
+      print_pgtbl(proc, 0, -1);
+    trace_printf("\n================================================================\n");
+  }
+}
+
+static void iodump_free(struct pcb_t *proc, uint32_t reg_index)
+{
+  if (TRACE_ON(TRACE_IO) && event_on)
+  {
+    int32_t arg[EVENT_NARGS] = {reg_index};
+    iodump_event(proc, EV_FREE, arg, 0);
+  }
+  else if (TRACE_ON(TRACE_IO))
+  {
+    trace_printf("===== PHYSICAL MEMORY AFTER DEALLOCATION =====\n");
+    trace_printf("PID=%d - Region=%d\n", proc->pid, reg_index);
+    iodump_end(proc, 0);
+  }
+}
+
+static void iodump_read(struct pcb_t *proc, uint32_t source, uint32_t offset,
+                        BYTE data)
+{
+  if (TRACE_ON(TRACE_IO) && event_on)
+  {
+    int32_t arg[EVENT_NARGS] = {source, offset, data};
+    iodump_event(proc, EV_READ, arg, 1);
+  }
+  else if (TRACE_ON(TRACE_IO))
+  {
+    trace_printf("===== PHYSICAL MEMORY AFTER READING =====\n");
+    trace_printf("read region=%d offset=%d value=%d\n", source, offset, data);
+    iodump_end(proc, 1);
+  }
+}
+
+static void iodump_write(struct pcb_t *proc, uint32_t destination,
+                         uint32_t offset, BYTE data)
+{
+  if (TRACE_ON(TRACE_IO) && event_on)
+  {
+    int32_t arg[EVENT_NARGS] = {destination, offset, data};
+    iodump_event(proc, EV_WRITE, arg, 1);
+  }
+  else if (TRACE_ON(TRACE_IO))
+  {
+    trace_printf("===== PHYSICAL MEMORY AFTER WRITING =====\n");
+    trace_printf("write region=%d offset=%d value=%d\n", destination, offset, data);
+    iodump_end(proc, 1);
+  }
+}
+
+static void iodump_memset(struct pcb_t *proc, uint32_t rgid, uint32_t offset,
+                          BYTE value, uint32_t size)
+{
+  if (TRACE_ON(TRACE_IO) && event_on)
+  {
+    int32_t arg[EVENT_NARGS] = {rgid, offset, value, size};
+    iodump_event(proc, EV_MEMSET, arg, 1);
+  }
+  else if (TRACE_ON(TRACE_IO))
+  {
+    trace_printf("===== PHYSICAL MEMORY AFTER MEMSET =====\n");
+    trace_printf("memset region=%d offset=%d value=%d size=%d\n", rgid, offset, value, size);
+    iodump_end(proc, 1);
+  }
+}
+
+static void iodump_memcpy(struct pcb_t *proc, uint32_t dst_rg, uint32_t dst_off,
+                          uint32_t src_rg, uint32_t src_off, uint32_t size)
+{
+  if (TRACE_ON(TRACE_IO) && event_on)
+  {
+    int32_t arg[EVENT_NARGS] = {dst_rg, dst_off, src_rg, src_off, size};
+    iodump_event(proc, EV_MEMCPY, arg, 1);
+  }
+  else if (TRACE_ON(TRACE_IO))
+  {
+    trace_printf("===== PHYSICAL MEMORY AFTER MEMCPY =====\n");
+    trace_printf("memcpy region=%d offset=%d from region=%d offset=%d size=%d\n",
+           dst_rg, dst_off, src_rg, src_off, size);
+    iodump_end(proc, 1);
+  }
+}
+
+static void iodump_memcmp(struct pcb_t *proc, uint32_t rg_a, uint32_t off_a,
+                          uint32_t rg_b, uint32_t off_b, uint32_t size,
+                          int result)
+{
+  if (TRACE_ON(TRACE_IO) && event_on)
+    EVENT(EV_MEMCMP, proc->pid, rg_a, off_a, rg_b, off_b, size, result);
+  else if (TRACE_ON(TRACE_IO))
+  {
+    trace_printf("===== PHYSICAL MEMORY AFTER MEMCMP =====\n");
+    trace_printf("memcmp region=%d offset=%d region=%d offset=%d size=%d result=%d\n",
+           rg_a, off_a, rg_b, off_b, size, result);
+  }
+}
+
+/*iodump_store - a RAM byte store. The trace renderer needs the stores
+ *for its memory dumps, they are recorded whatever the categories
+ */
+static void iodump_store(struct pcb_t *proc, int phyaddr, BYTE value)
+{
+  if (event_on)
+    EVENT(EV_STORE, proc->pid, phyaddr, value, TRACE_ON(TRACE_MEMIO) != 0);
+  else if (TRACE_ON(TRACE_MEMIO))
+  {
+    trace_printf("Value to write: %d\n", value);
+    trace_printf("Pphysical address: %d\n", phyaddr);
+  }
+}
+
 /*liballoc - PAGING-based allocate a region memory
  *@proc:  Process executing the instruction
  *@size: allocated size
@@ -234,14 +439,7 @@ int liballoc(struct pcb_t *proc, uint32_t size, uint32_t reg_index)
 
   __alloc(proc, 0, (int)reg_index, (int)size, &addr);
 
-  #ifdef IODUMP
-  printf("===== PHYSICAL MEMORY AFTER ALLOCATION =====\n");
-  printf("PID=%d - Region=%d - Address=%08x - Size=%d byte\n", proc->pid, reg_index, addr, size);
-  #ifdef PAGETBL_DUMP
-  print_pgtbl(proc, 0, -1);
-  #endif
-  printf("\n================================================================\n");
-  #endif
+  iodump_alloc(proc, reg_index, addr, size);
 
   /* By default using vmaid = 0 */
   return 0;
@@ -258,14 +456,7 @@ int libfree(struct pcb_t *proc, uint32_t reg_index)
   /* TODO Implement free region */
   __free(proc, 0, reg_index);
 
-  #ifdef IODUMP
-  printf("===== PHYSICAL MEMORY AFTER DEALLOCATION =====\n");
-  printf("PID=%d - Region=%d\n", proc->pid, reg_index);
-  #ifdef PAGETBL_DUMP
-  print_pgtbl(proc, 0, -1);
-  #endif
-  printf("================================================================\n");
-  #endif
+  iodump_free(proc, reg_index);
 
   /* By default using vmaid = 0 */
   return 0;
@@ -287,6 +478,10 @@ int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
     int vicpgn, swpfpn;
     int vicfpn;
     uint32_t vicpte;
+
+    caller->perf.page_faults++;
+    if (event_on)
+      EVENT(EV_FAULT, caller->pid, pgn);
     
     //int tgtfpn = PAGING_PTE_SWP(pte);//the target frame storing our variable
    
@@ -319,6 +514,7 @@ int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
     regs.a3 = swpfpn;
 
     syscall(caller, 17, &regs);
+    caller->perf.swap_out++;
 
     /* TODO copy target frame form swap to mem 
      * SWP(tgtfpn <--> vicfpn)
@@ -345,6 +541,7 @@ int pg_getpage(struct mm_struct *mm, int pgn, int *fpn, struct pcb_t *caller)
     regs.a2 = swpoff;
     regs.a3 = vicfpn;
     syscall(caller, 17, &regs);
+    caller->perf.swap_in++;
 
     pte_set_fpn(&mm->pgd[pgn], vicfpn);
 
@@ -379,7 +576,7 @@ int pg_getval(struct mm_struct *mm, int addr, BYTE *data, struct pcb_t *caller)
    *  MEMPHY READ 
    *  SYSCALL 17 sys_memmap with SYSMEM_IO_READ
    */
-  int phyaddr = fpn * PAGE_SIZE + off;
+  int phyaddr = fpn * PAGING_PAGESZ + off;
   struct sc_regs regs;
   regs.a1 = SYSMEM_IO_READ;
   regs.a2 = phyaddr;
@@ -418,11 +615,11 @@ int pg_setval(struct mm_struct *mm, int addr, BYTE value, struct pcb_t *caller)
    *  MEMPHY WRITE
    *  SYSCALL 17 sys_memmap with SYSMEM_IO_WRITE
    */
-  int phyaddr = fpn * PAGE_SIZE + off;
-  printf("Value to write: %d\n", value);
-  printf("Pphysical address: %d\n", phyaddr);
+  int phyaddr = fpn * PAGING_PAGESZ + off;
+  iodump_store(caller, phyaddr, value);
   if(phyaddr < 0 || phyaddr >= caller->mram->maxsz) {
-    printf("Invalid physical address: %d\n", phyaddr);
+    if (TRACE_ON(TRACE_MEMIO) && !event_on)
+      trace_printf("Invalid physical address: %d\n", phyaddr);
     return -1;
   }
   struct sc_regs regs;
@@ -479,15 +676,7 @@ int libread(
   *destination = (uint32_t)data;
   /* TODO update result of reading action*/
   //destination 
-#ifdef IODUMP
-  printf("===== PHYSICAL MEMORY AFTER READING =====\n");
-  printf("read region=%d offset=%d value=%d\n", source, offset, data);
-#ifdef PAGETBL_DUMP
-  print_pgtbl(proc, 0, -1); //print max TBL
-#endif
-  MEMPHY_dump(proc->mram);
-  printf("================================================================\n");
-#endif
+  iodump_read(proc, source, offset, data);
 
   return val;
 }
@@ -510,7 +699,7 @@ int __write(struct pcb_t *caller, int vmaid, int rgid, int offset, BYTE value)
 
   if (currg == NULL || cur_vma == NULL) /* Invalid memory identify */
   {
-    pthread_mutex_lock(&mmvm_lock);
+    pthread_mutex_unlock(&mmvm_lock);
     return -1;
   }
   pg_setval(caller->mm, currg->rg_start + offset, value, caller);
@@ -525,19 +714,279 @@ int libwrite(
     uint32_t destination, // Index of destination register
     uint32_t offset)
 {
-#ifdef IODUMP
-  printf("===== PHYSICAL MEMORY AFTER WRITING =====\n");
-  printf("write region=%d offset=%d value=%d\n", destination, offset, data);
-#ifdef PAGETBL_DUMP
-  print_pgtbl(proc, 0, -1); //print max TBL
-#endif
-  MEMPHY_dump(proc->mram);
-  printf("================================================================\n");
-#endif
+  iodump_write(proc, destination, offset, data);
 
   return __write(proc, 0, destination, offset, data);
 }
 
+/* Bulk region operations. An instruction takes mmvm_lock once and moves
+ * whole page spans through MEMPHY block accesses, instead of one
+ * sys_memmap round trip per byte as __read()/__write() do.
+ */
+
+/*rg_span - virtual address of [offset] in region [rgid], -1 if the
+ *[size] bytes from there do not fit in the region
+ */
+static int rg_span(struct pcb_t *caller, int rgid, int offset, int size)
+{
+  struct vm_rg_struct *rg = get_symrg_byid(caller->mm, rgid);
+
+  if (rg == NULL || offset < 0 || size < 0 ||
+      rg->rg_start + offset + size > rg->rg_end)
+    return -1;
+
+  return rg->rg_start + offset;
+}
+
+/*pg_room - length of the longest span of [size] bytes at most within
+ *one page, starting at [addr] or ending at it when [back] is set
+ */
+static int pg_room(int addr, int size, int back)
+{
+  int n = back ? PAGING_OFFST(addr) + 1 : PAGING_PAGESZ - PAGING_OFFST(addr);
+
+  return (size < n) ? size : n;
+}
+
+/*pg_span - physical address of the span pg_room() gives, bringing its
+ *page in
+ *@len: span length
+ */
+static int pg_span(struct pcb_t *caller, int addr, int size, int back, int *len)
+{
+  int fpn;
+
+  if (pg_getpage(caller->mm, PAGING_PGN(addr), &fpn, caller) != 0)
+    return -1;
+
+  *len = pg_room(addr, size, back);
+  if (back)
+    addr -= *len - 1;
+  return fpn * PAGING_PAGESZ + PAGING_OFFST(addr);
+}
+
+/*move_event - record a RAM move of [n] bytes read from [physrc] into [buf].
+ *EV_MOVE is replayed from the source frame, so the bytes themselves are
+ *recorded when the page at [src] has left that frame since
+ */
+static void move_event(struct pcb_t *caller, int src, int physrc,
+                       int phydst, BYTE *buf, int n)
+{
+  uint32_t pte = caller->mm->pgd[PAGING_PGN(src)];
+  int i;
+
+  if (PAGING_PAGE_PRESENT(pte) && !(pte & PAGING_PTE_SWAPPED_MASK) &&
+      PAGING_FPN(pte) == physrc / PAGING_PAGESZ)
+  {
+    EVENT(EV_MOVE, caller->pid, phydst, physrc, n);
+    return;
+  }
+  for (i = 0; i < n; i++)
+    EVENT(EV_STORE, caller->pid, phydst + i, buf[i], 0);
+}
+
+/*__memset - set a span of a region memory to one value
+ *@caller: caller
+ *@vmaid: ID vm area of the region
+ *@rgid: memory region ID
+ *@offset: offset of the span in the region
+ *@value: written value
+ *@size: span size
+ */
+int __memset(struct pcb_t *caller, int vmaid, int rgid, int offset, BYTE value, int size)
+{
+  int addr, phyaddr, n;
+
+  pthread_mutex_lock(&mmvm_lock);
+  addr = rg_span(caller, rgid, offset, size);
+  if (addr < 0 || get_vma_by_num(caller->mm, vmaid) == NULL)
+  {
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
+
+  for (; size > 0; size -= n, addr += n)
+  {
+    phyaddr = pg_span(caller, addr, size, 0, &n);
+    if (phyaddr < 0 || MEMPHY_fill(caller->mram, phyaddr, value, n) != 0)
+    {
+      pthread_mutex_unlock(&mmvm_lock);
+      return -1;
+    }
+    if (event_on)
+      EVENT(EV_FILL, caller->pid, phyaddr, value, n);
+  }
+
+  pthread_mutex_unlock(&mmvm_lock);
+  return 0;
+}
+
+/*__memcpy - copy a span between region memories, overlapping spans of
+ *the same region are copied as memmove() does
+ *@caller: caller
+ *@vmaid: ID vm area of the regions
+ *@dst_rg, @dst_off: destination region ID and offset
+ *@src_rg, @src_off: source region ID and offset
+ *@size: span size
+ */
+int __memcpy(struct pcb_t *caller, int vmaid, int dst_rg, int dst_off,
+             int src_rg, int src_off, int size)
+{
+  BYTE buf[PAGING_PAGESZ];
+  int dst, src, back, n, m;
+  int phydst, physrc;
+
+  pthread_mutex_lock(&mmvm_lock);
+  dst = rg_span(caller, dst_rg, dst_off, size);
+  src = rg_span(caller, src_rg, src_off, size);
+  if (dst < 0 || src < 0 || get_vma_by_num(caller->mm, vmaid) == NULL)
+  {
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
+
+  /* Walk from the end when the destination overlaps the source tail */
+  back = dst > src && dst < src + size;
+  if (back)
+  {
+    dst += size - 1;
+    src += size - 1;
+  }
+
+  while (size > 0)
+  {
+    physrc = pg_span(caller, src, size, back, &n);
+    if (physrc < 0)
+    {
+      pthread_mutex_unlock(&mmvm_lock);
+      return -1;
+    }
+    /* The span ends at whichever page boundary comes first. Read it
+     * before the destination page is brought in: that fault may evict
+     * the source page and hand its frame over */
+    m = pg_room(dst, n, back);
+    if (back)
+      physrc += n - m;
+    MEMPHY_read_block(caller->mram, physrc, buf, m);
+
+    phydst = pg_span(caller, dst, m, back, &m);
+    if (phydst < 0)
+    {
+      pthread_mutex_unlock(&mmvm_lock);
+      return -1;
+    }
+    MEMPHY_write_block(caller->mram, phydst, buf, m);
+    if (event_on)
+      move_event(caller, src, physrc, phydst, buf, m);
+
+    size -= m;
+    src += back ? -m : m;
+    dst += back ? -m : m;
+  }
+
+  pthread_mutex_unlock(&mmvm_lock);
+  return 0;
+}
+
+/*__memcmp - compare two spans of region memories
+ *@caller: caller
+ *@vmaid: ID vm area of the regions
+ *@rg_a, @off_a: first region ID and offset
+ *@rg_b, @off_b: second region ID and offset
+ *@size: span size
+ *@result: sign of the first differing byte, as memcmp()
+ */
+int __memcmp(struct pcb_t *caller, int vmaid, int rg_a, int off_a,
+             int rg_b, int off_b, int size, int *result)
+{
+  BYTE buf_a[PAGING_PAGESZ], buf_b[PAGING_PAGESZ];
+  int a, b, n, m;
+  int phya, phyb;
+
+  pthread_mutex_lock(&mmvm_lock);
+  a = rg_span(caller, rg_a, off_a, size);
+  b = rg_span(caller, rg_b, off_b, size);
+  if (a < 0 || b < 0 || get_vma_by_num(caller->mm, vmaid) == NULL)
+  {
+    pthread_mutex_unlock(&mmvm_lock);
+    return -1;
+  }
+
+  *result = 0;
+  for (; size > 0 && *result == 0; size -= m, a += m, b += m)
+  {
+    phya = pg_span(caller, a, size, 0, &n);
+    if (phya < 0)
+    {
+      pthread_mutex_unlock(&mmvm_lock);
+      return -1;
+    }
+    /* Read the first span before the second page is brought in, that
+     * fault may evict the first page */
+    m = pg_room(b, n, 0);
+    MEMPHY_read_block(caller->mram, phya, buf_a, m);
+
+    phyb = pg_span(caller, b, m, 0, &m);
+    if (phyb < 0)
+    {
+      pthread_mutex_unlock(&mmvm_lock);
+      return -1;
+    }
+    MEMPHY_read_block(caller->mram, phyb, buf_b, m);
+    *result = memcmp(buf_a, buf_b, m);
+  }
+  if (*result != 0)
+    *result = (*result > 0) ? 1 : -1;
+
+  pthread_mutex_unlock(&mmvm_lock);
+  return 0;
+}
+
+/*libmemset - PAGING-based memset on a region memory */
+int libmemset(
+    struct pcb_t *proc, // Process executing the instruction
+    uint32_t rgid,      // Index of destination region
+    uint32_t offset,    // Destination address = [rgid] + [offset]
+    BYTE value,         // Data to be written into memory
+    uint32_t size)      // Number of bytes
+{
+  int val = __memset(proc, 0, rgid, offset, value, size);
+  iodump_memset(proc, rgid, offset, value, size);
+
+  return val;
+}
+
+/*libmemcpy - PAGING-based memcpy between region memories */
+int libmemcpy(
+    struct pcb_t *proc, // Process executing the instruction
+    uint32_t dst_rg,    // Index of destination region
+    uint32_t dst_off,   // Destination address = [dst_rg] + [dst_off]
+    uint32_t src_rg,    // Index of source region
+    uint32_t src_off,   // Source address = [src_rg] + [src_off]
+    uint32_t size)      // Number of bytes
+{
+  int val = __memcpy(proc, 0, dst_rg, dst_off, src_rg, src_off, size);
+  iodump_memcpy(proc, dst_rg, dst_off, src_rg, src_off, size);
+
+  return val;
+}
+
+/*libmemcmp - PAGING-based memcmp between region memories */
+int libmemcmp(
+    struct pcb_t *proc, // Process executing the instruction
+    uint32_t rg_a,      // Index of first region
+    uint32_t off_a,     // First address = [rg_a] + [off_a]
+    uint32_t rg_b,      // Index of second region
+    uint32_t off_b,     // Second address = [rg_b] + [off_b]
+    uint32_t size,      // Number of bytes
+    int *result)
+{
+  int val = __memcmp(proc, 0, rg_a, off_a, rg_b, off_b, size, result);
+  iodump_memcmp(proc, rg_a, off_a, rg_b, off_b, size, (val == 0) ? *result : 0);
+
+  return val;
+}
+
 /*free_pcb_memphy - collect all memphy of pcb
  *@caller: caller
  *@vmaid: ID vm area to alloc memory region
@@ -619,7 +1068,7 @@ int get_free_vmrg_area(struct pcb_t *caller, int vmaid, int size, struct vm_rg_s
         rgit->rg_start += size;
 
         if(rgit->rg_start >= rgit->rg_end) {
-          if(prev != NULL) {
+          if(prev == NULL) {
             cur_vma->vm_freerg_list = rgit->rg_next;
           }
           else {
@@ -1,10 +1,26 @@
 
 #include "loader.h"
+#include "cpu.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-static uint32_t avail_pid = 1;
+/* Program images, parsed once per path. The code segment of an image is
+ * read-only and shared by every PCB loaded from that path */
+struct image_t {
+	char * path;
+	uint32_t priority;
+	struct code_seg_t * code;
+	struct image_t * next;
+};
+
+static struct image_t * images = NULL;
+static pthread_mutex_t image_lock = PTHREAD_MUTEX_INITIALIZER;
 
 #define OPT_CALC	"calc"
 #define OPT_ALLOC	"alloc"
@@ -12,6 +28,9 @@ static uint32_t avail_pid = 1;
 #define OPT_READ	"read"
 #define OPT_WRITE	"write"
 #define OPT_SYSCALL	"syscall"
+#define OPT_MEMSET	"memset"
+#define OPT_MEMCPY	"memcpy"
+#define OPT_MEMCMP	"memcmp"
 
 static enum ins_opcode_t get_opcode(char * opt) {
 	if (!strcmp(opt, OPT_CALC)) {
@@ -26,21 +45,23 @@ static enum ins_opcode_t get_opcode(char * opt) {
 		return WRITE;
 	}else if (!strcmp(opt, OPT_SYSCALL)) {
 		return SYSCALL;
+	}else if (!strcmp(opt, OPT_MEMSET)) {
+		return MEMSET;
+	}else if (!strcmp(opt, OPT_MEMCPY)) {
+		return MEMCPY;
+	}else if (!strcmp(opt, OPT_MEMCMP)) {
+		return MEMCMP;
 	}else{
 		printf("get_opcode return Opcode: %s\n", opt);
 		exit(1);
 	}
 }
 
-struct pcb_t * load(const char * path) {
-	/* Create new PCB for the new process */
-	struct pcb_t * proc = (struct pcb_t * )malloc(sizeof(struct pcb_t));
-	proc->pid = avail_pid;
-	avail_pid++;
-	proc->page_table =
-		(struct page_table_t*)malloc(sizeof(struct page_table_t));
-	proc->bp = PAGE_SIZE;
-	proc->pc = 0;
+_Static_assert(sizeof(struct inst_t) == 28,
+	"struct inst_t is the compiled program record");
+
+struct code_seg_t * parse_program(const char * path, uint32_t * priority) {
+	struct code_seg_t * code;
 
 	/* Read process code from file */
 	FILE * file;
@@ -48,49 +69,83 @@ struct pcb_t * load(const char * path) {
 		printf("Cannot find process description at '%s'\n", path);
 		exit(1);		
 	}
-	snprintf(proc->path, 2*sizeof(path)+1, "%s", path);
 	char opcode[10];
-	proc->code = (struct code_seg_t*)malloc(sizeof(struct code_seg_t));
-	fscanf(file, "%u %u", &proc->priority, &proc->code->size);
-	proc->code->text = (struct inst_t*)malloc(
-		sizeof(struct inst_t) * proc->code->size
+	code = (struct code_seg_t*)malloc(sizeof(struct code_seg_t));
+	code->size = 0;	/* Empty program if the header is unreadable */
+	fscanf(file, "%u %u", priority, &code->size);
+	/* Zeroed: unused operands are written out by ossim-as */
+	code->text = (struct inst_t*)calloc(
+		code->size, sizeof(struct inst_t)
 	);
 	uint32_t i = 0;
 	char buf[200];
-	for (i = 0; i < proc->code->size; i++) {
+	for (i = 0; i < code->size; i++) {
 		fscanf(file, "%s", opcode);
-		proc->code->text[i].opcode = get_opcode(opcode);
-		switch(proc->code->text[i].opcode) {
+		code->text[i].opcode = get_opcode(opcode);
+		switch(code->text[i].opcode) {
 		case CALC:
 			break;
 		case ALLOC:
 			fscanf(
 				file,
 				"%u %u\n",
-				&proc->code->text[i].arg_0,
-				&proc->code->text[i].arg_1
+				&code->text[i].arg_0,
+				&code->text[i].arg_1
 			);
 			break;
 		case FREE:
-			fscanf(file, "%u\n", &proc->code->text[i].arg_0);
+			fscanf(file, "%u\n", &code->text[i].arg_0);
 			break;
 		case READ:
 		case WRITE:
 			fscanf(
 				file,
 				"%u %u %u\n",
-				&proc->code->text[i].arg_0,
-				&proc->code->text[i].arg_1,
-				&proc->code->text[i].arg_2
+				&code->text[i].arg_0,
+				&code->text[i].arg_1,
+				&code->text[i].arg_2
 			);
 			break;	
+		case MEMSET:
+			fscanf(
+				file,
+				"%u %u %u %u\n",
+				&code->text[i].arg_0,
+				&code->text[i].arg_1,
+				&code->text[i].arg_2,
+				&code->text[i].arg_3
+			);
+			break;
+		case MEMCPY:
+			fscanf(
+				file,
+				"%u %u %u %u %u\n",
+				&code->text[i].arg_0,
+				&code->text[i].arg_1,
+				&code->text[i].arg_2,
+				&code->text[i].arg_3,
+				&code->text[i].arg_4
+			);
+			break;
+		case MEMCMP:
+			fscanf(
+				file,
+				"%u %u %u %u %u %u\n",
+				&code->text[i].arg_0,
+				&code->text[i].arg_1,
+				&code->text[i].arg_2,
+				&code->text[i].arg_3,
+				&code->text[i].arg_4,
+				&code->text[i].arg_5
+			);
+			break;
 		case SYSCALL:
 			fgets(buf, sizeof(buf), file);
 			sscanf(buf, "%d%d%d%d",
-			           &proc->code->text[i].arg_0,
-			           &proc->code->text[i].arg_1,
-			           &proc->code->text[i].arg_2,
-			           &proc->code->text[i].arg_3
+			           &code->text[i].arg_0,
+			           &code->text[i].arg_1,
+			           &code->text[i].arg_2,
+			           &code->text[i].arg_3
 			);
 			break;
 		default:
@@ -98,8 +153,142 @@ struct pcb_t * load(const char * path) {
 			exit(1);
 		}
 	}
+	fclose(file);
+	decode(code);
+	code->refs = 0;
+	code->map = NULL;
+	code->map_len = 0;
+	return code;
+}
+
+/* Map the compiled program at [path], NULL if it is not one */
+static struct code_seg_t * map_program(const char * path, uint32_t * priority) {
+	struct code_seg_t * code;
+	struct prog_hdr_t * hdr;
+	struct stat st;
+	void * map;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		return NULL;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(*hdr)) {
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+
+	hdr = (struct prog_hdr_t*)map;
+	if (hdr->magic != PROG_MAGIC || hdr->version != PROG_VERSION ||
+		st.st_size != (off_t)(sizeof(*hdr) +
+			(uint64_t)hdr->size * sizeof(struct inst_t))) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+
+	code = (struct code_seg_t*)malloc(sizeof(struct code_seg_t));
+	code->text = (struct inst_t*)(hdr + 1);
+	code->size = hdr->size;
+	code->map = map;
+	code->map_len = st.st_size;
+	*priority = hdr->priority;
+	decode(code);
+	code->refs = 0;
+	return code;
+}
+
+/* Code segment of the program at [path]: its compiled copy when there is
+ * an up to date one, else the program itself, compiled or text */
+static struct code_seg_t * read_program(const char * path, uint32_t * priority) {
+	struct code_seg_t * code;
+	struct stat src, obj;
+	char bin[256];
+
+	snprintf(bin, sizeof(bin), "%s%s", path, PROG_SUFFIX);
+	if (stat(bin, &obj) == 0 &&
+		(stat(path, &src) != 0 || obj.st_mtime >= src.st_mtime) &&
+		(code = map_program(bin, priority)) != NULL) {
+		return code;
+	}
+	if ((code = map_program(path, priority)) != NULL) {
+		return code;
+	}
+	return parse_program(path, priority);
+}
+
+/* Code segment of the program at [path], parsed on first use and shared
+ * from then on. [priority] is the default one from the file header */
+static struct code_seg_t * get_image(const char * path, uint32_t * priority) {
+	struct image_t * image;
+
+	pthread_mutex_lock(&image_lock);
+	for (image = images; image != NULL; image = image->next) {
+		if (!strcmp(image->path, path)) {
+			break;
+		}
+	}
+	if (image == NULL) {
+		image = (struct image_t*)malloc(sizeof(struct image_t));
+		image->path = strdup(path);
+		image->code = read_program(path, &image->priority);
+		/* The reference of the cache itself */
+		image->code->refs = 1;
+		image->next = images;
+		images = image;
+	}
+	__atomic_add_fetch(&image->code->refs, 1, __ATOMIC_RELAXED);
+	*priority = image->priority;
+	pthread_mutex_unlock(&image_lock);
+	return image->code;
+}
+
+static void put_code(struct code_seg_t * code) {
+	if (__atomic_sub_fetch(&code->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+		if (code->map != NULL) {
+			munmap(code->map, code->map_len);
+		}else{
+			free(code->text);
+		}
+		free(code->ops);
+		free(code);
+	}
+}
+
+struct pcb_t * load(const char * path) {
+	/* Create new PCB for the new process */
+	struct pcb_t * proc = (struct pcb_t * )malloc(sizeof(struct pcb_t));
+	proc->pid = 0;
+	proc->page_table =
+		(struct page_table_t*)malloc(sizeof(struct page_table_t));
+	proc->bp = PAGE_SIZE;
+	proc->pc = 0;
+	memset(&proc->perf, 0, sizeof(proc->perf));
+
+	proc->code = get_image(path, &proc->priority);
+	snprintf(proc->path, 2*sizeof(path)+1, "%s", path);
 	return proc;
 }
 
+void unload(struct pcb_t * proc) {
+	put_code(proc->code);
+	proc->code = NULL;
+}
 
+void flush_images(void) {
+	struct image_t * image;
+
+	pthread_mutex_lock(&image_lock);
+	while (images != NULL) {
+		image = images;
+		images = images->next;
+		put_code(image->code);
+		free(image->path);
+		free(image);
+	}
+	pthread_mutex_unlock(&image_lock);
+}
 
@@ -5,9 +5,37 @@
  */
 
 #include "mm.h"
+#include "trace.h"
+#include "event.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+
+#define FRAME_BITS (8 * sizeof(unsigned long))
+
+/*
+ *  MEMPHY_mark - note that [n] bytes from [addr] may not be zero, for
+ *  MEMPHY_dump to visit their frames
+ *  @mp: memphy struct
+ *  @addr: address of the first byte
+ *  @n: number of bytes
+ */
+static void MEMPHY_mark(struct memphy_struct *mp, int addr, int n)
+{
+   int fpn, last = (addr + n - 1) / PAGING_PAGESZ;
+   unsigned long bit;
+
+   for (fpn = addr / PAGING_PAGESZ; n > 0 && fpn <= last; fpn++)
+   {
+      bit = 1UL << (fpn % FRAME_BITS);
+      /* Already set on every write but the first one to the frame */
+      if (!(__atomic_load_n(&mp->used_frames[fpn / FRAME_BITS],
+                            __ATOMIC_RELAXED) & bit))
+         __atomic_or_fetch(&mp->used_frames[fpn / FRAME_BITS], bit,
+                           __ATOMIC_RELAXED);
+   }
+}
 
 /*
  *  MEMPHY_mv_csr - move MEMPHY cursor
@@ -85,6 +113,8 @@ int MEMPHY_seq_write(struct memphy_struct *mp, int addr, BYTE value)
 
    MEMPHY_mv_csr(mp, addr);
    mp->storage[addr] = value;
+   if (value != 0)
+      MEMPHY_mark(mp, addr, 1);
 
    return 0;
 }
@@ -101,7 +131,11 @@ int MEMPHY_write(struct memphy_struct *mp, int addr, BYTE data)
       return -1;
 
    if (mp->rdmflg)
+   {
       mp->storage[addr] = data;
+      if (data != 0)
+         MEMPHY_mark(mp, addr, 1);
+   }
    else /* Sequential access device */
       return MEMPHY_seq_write(mp, addr, data);
 
@@ -122,6 +156,8 @@ int MEMPHY_format(struct memphy_struct *mp, int pagesz)
    if (numfp <= 0)
       return -1;
 
+   mp->nr_free = numfp;
+
    /* Init head of free framephy list */
    fst = malloc(sizeof(struct framephy_struct));
    fst->fpn = iter;
@@ -140,6 +176,66 @@ int MEMPHY_format(struct memphy_struct *mp, int pagesz)
    return 0;
 }
 
+/*
+ *  MEMPHY_fill - set a block of MEMPHY device to one value
+ *  @mp: memphy struct
+ *  @addr: address of the first byte
+ *  @value: written value
+ *  @n: number of bytes
+ */
+int MEMPHY_fill(struct memphy_struct *mp, int addr, BYTE value, int n)
+{
+   if (mp == NULL || addr < 0 || n < 0 || addr + n > mp->maxsz)
+      return -1;
+
+   if (!mp->rdmflg) /* Sequential access device, one seek per block */
+      MEMPHY_mv_csr(mp, addr);
+   memset(mp->storage + addr, value, n);
+   if (value != 0)
+      MEMPHY_mark(mp, addr, n);
+
+   return 0;
+}
+
+/*
+ *  MEMPHY_read_block - read a block of MEMPHY device
+ *  @mp: memphy struct
+ *  @addr: address of the first byte
+ *  @buf: obtained values
+ *  @n: number of bytes
+ */
+int MEMPHY_read_block(struct memphy_struct *mp, int addr, BYTE *buf, int n)
+{
+   if (mp == NULL || addr < 0 || n < 0 || addr + n > mp->maxsz)
+      return -1;
+
+   if (!mp->rdmflg)
+      MEMPHY_mv_csr(mp, addr);
+   memcpy(buf, mp->storage + addr, n);
+
+   return 0;
+}
+
+/*
+ *  MEMPHY_write_block - write a block of MEMPHY device
+ *  @mp: memphy struct
+ *  @addr: address of the first byte
+ *  @buf: written values
+ *  @n: number of bytes
+ */
+int MEMPHY_write_block(struct memphy_struct *mp, int addr, const BYTE *buf, int n)
+{
+   if (mp == NULL || addr < 0 || n < 0 || addr + n > mp->maxsz)
+      return -1;
+
+   if (!mp->rdmflg)
+      MEMPHY_mv_csr(mp, addr);
+   memmove(mp->storage + addr, buf, n);
+   MEMPHY_mark(mp, addr, n);
+
+   return 0;
+}
+
 int MEMPHY_get_freefp(struct memphy_struct *mp, int *retfpn)
 {
    struct framephy_struct *fp = mp->free_fp_list;
@@ -149,6 +245,9 @@ int MEMPHY_get_freefp(struct memphy_struct *mp, int *retfpn)
 
    *retfpn = fp->fpn;
    mp->free_fp_list = fp->fp_next;
+   mp->nr_free--;
+   if (event_on)
+      EVENT(EV_FRAMES, 0, mp->id, mp->nr_free);
 
    /* MEMPHY is iteratively used up until its exhausted
     * No garbage collector acting then it not been released
@@ -167,14 +266,36 @@ int MEMPHY_dump(struct memphy_struct *mp)
    return -1;
   }
 
-  printf("===== PHYSICAL MEMORY DUMP =====\n");
-  for(int i = 0; i < mp->maxsz; i++) {
-   if(mp->storage[i] != 0) {
-      printf("BYTE %08x: %d\n", i, mp->storage[i]);
+  trace_printf("===== PHYSICAL MEMORY DUMP =====\n");
+  /* Only the frames ever written with non-zero bytes, and within them
+   * a word at a time until a non-zero one */
+  int nr_frames = (mp->maxsz + PAGING_PAGESZ - 1) / PAGING_PAGESZ;
+  for(int w = 0; w * (int)FRAME_BITS < nr_frames; w++) {
+   unsigned long bits = __atomic_load_n(&mp->used_frames[w], __ATOMIC_RELAXED);
+   while (bits != 0) {
+      int fpn = w * FRAME_BITS + __builtin_ctzl(bits);
+      int i = fpn * PAGING_PAGESZ;
+      int end = (i + PAGING_PAGESZ < mp->maxsz) ? i + PAGING_PAGESZ : mp->maxsz;
+      uint64_t word;
+
+      bits &= bits - 1;
+      while (i < end) {
+         if (i + (int)sizeof(word) <= end) {
+            memcpy(&word, mp->storage + i, sizeof(word));
+            if (word == 0) {
+               i += sizeof(word);
+               continue;
+            }
+         }
+         if(mp->storage[i] != 0) {
+            trace_printf("BYTE %08x: %d\n", i, mp->storage[i]);
+         }
+         i++;
+      }
    }
   }
-  printf("===== PHYSICAL MEMORY END-DUMP =====\n");
-  printf("================================================================\n");
+  trace_printf("===== PHYSICAL MEMORY END-DUMP =====\n");
+  trace_printf("================================================================\n");
    return 0;
 }
 
@@ -187,6 +308,9 @@ int MEMPHY_put_freefp(struct memphy_struct *mp, int fpn)
    newnode->fpn = fpn;
    newnode->fp_next = fp;
    mp->free_fp_list = newnode;
+   mp->nr_free++;
+   if (event_on)
+      EVENT(EV_FRAMES, 0, mp->id, mp->nr_free);
 
    return 0;
 }
@@ -199,6 +323,8 @@ int init_memphy(struct memphy_struct *mp, int max_size, int randomflg)
    mp->storage = (BYTE *)malloc(max_size * sizeof(BYTE));
    mp->maxsz = max_size;
    memset(mp->storage, 0, max_size * sizeof(BYTE));
+   mp->used_frames = calloc((max_size / PAGING_PAGESZ + FRAME_BITS) / FRAME_BITS,
+                            sizeof(unsigned long));
 
    MEMPHY_format(mp, PAGING_PAGESZ);
 
@@ -6,6 +6,7 @@
 
 #include "string.h"
 #include "mm.h"
+#include "event.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <pthread.h>
@@ -38,6 +39,9 @@ struct vm_area_struct *get_vma_by_num(struct mm_struct *mm, int vmaid)
 
 int __mm_swap_page(struct pcb_t *caller, int vicfpn , int swpfpn)
 {
+    if (event_on)
+      EVENT(EV_SWAP, caller->pid, caller->mram->id, vicfpn,
+            caller->active_mswp->id, swpfpn);
     __swap_cp_page(caller->mram, vicfpn, caller->active_mswp, swpfpn);
     return 0;
 }
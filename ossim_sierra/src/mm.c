@@ -5,6 +5,8 @@
  */
 
 #include "mm.h"
+#include "trace.h"
+#include "event.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -177,6 +179,9 @@ int alloc_pages_range(struct pcb_t *caller, int req_pgnum, struct framephy_struc
       if (MEMPHY_get_freefp(caller->active_mswp, &swap_fpn) != 0) {
           return -3000;
       }
+      if (event_on)
+        EVENT(EV_SWAP, caller->pid, caller->mram->id, victim_fpn,
+              caller->active_mswp->id, swap_fpn);
       __swap_cp_page(caller->mram, victim_fpn, caller->active_mswp, swap_fpn);
       MEMPHY_put_freefp(caller->mram, victim_fpn);
 
@@ -228,7 +233,7 @@ int vm_map_ram(struct pcb_t *caller, int astart, int aend, int mapstart, int inc
   if (ret_alloc == -3000)
   {
 #ifdef MMDBG
-    printf("OOM: vm_map_ram out of memory \n");
+    trace_printf("OOM: vm_map_ram out of memory \n");
 #endif
     return -1;
   }
@@ -301,7 +306,7 @@ int init_mm(struct mm_struct *mm, struct pcb_t *caller)
   vma0->vm_end = vma0->vm_start;
   //vma0->sbrk = vma0->vm_start;
   vma0->sbrk = vma0->vm_start;
-  vma1->vm_freerg_list = NULL;
+  vma0->vm_freerg_list = NULL;
   
   struct vm_rg_struct *first_rg = init_vm_rg(vma0->vm_start, vma0->vm_end);
   enlist_vm_rg_node(&vma0->vm_freerg_list, first_rg);
@@ -357,19 +362,35 @@ int enlist_pgn_node(struct pgn_t **plist, int pgn)
   return 0;
 }
 
+int delist_pgn_node(struct pgn_t **plist, int pgn)
+{
+  struct pgn_t *pnode;
+
+  for (; *plist != NULL; plist = &(*plist)->pg_next)
+    if ((*plist)->pgn == pgn)
+    {
+      pnode = *plist;
+      *plist = pnode->pg_next;
+      free(pnode);
+      return 0;
+    }
+
+  return -1;
+}
+
 int print_list_fp(struct framephy_struct *ifp)
 {
   struct framephy_struct *fp = ifp;
 
-  printf("print_list_fp: ");
-  if (fp == NULL) { printf("NULL list\n"); return -1;}
-  printf("\n");
+  trace_printf("print_list_fp: ");
+  if (fp == NULL) { trace_printf("NULL list\n"); return -1;}
+  trace_printf("\n");
   while (fp != NULL)
   {
-    printf("fp[%d]\n", fp->fpn);
+    trace_printf("fp[%d]\n", fp->fpn);
     fp = fp->fp_next;
   }
-  printf("\n");
+  trace_printf("\n");
   return 0;
 }
 
@@ -377,15 +398,15 @@ int print_list_rg(struct vm_rg_struct *irg)
 {
   struct vm_rg_struct *rg = irg;
 
-  printf("print_list_rg: ");
-  if (rg == NULL) { printf("NULL list\n"); return -1; }
-  printf("\n");
+  trace_printf("print_list_rg: ");
+  if (rg == NULL) { trace_printf("NULL list\n"); return -1; }
+  trace_printf("\n");
   while (rg != NULL)
   {
-    printf("rg[%ld->%ld]\n", rg->rg_start, rg->rg_end);
+    trace_printf("rg[%ld->%ld]\n", rg->rg_start, rg->rg_end);
     rg = rg->rg_next;
   }
-  printf("\n");
+  trace_printf("\n");
   return 0;
 }
 
@@ -393,29 +414,29 @@ int print_list_vma(struct vm_area_struct *ivma)
 {
   struct vm_area_struct *vma = ivma;
 
-  printf("print_list_vma: ");
-  if (vma == NULL) { printf("NULL list\n"); return -1; }
-  printf("\n");
+  trace_printf("print_list_vma: ");
+  if (vma == NULL) { trace_printf("NULL list\n"); return -1; }
+  trace_printf("\n");
   while (vma != NULL)
   {
-    printf("va[%ld->%ld]\n", vma->vm_start, vma->vm_end);
+    trace_printf("va[%ld->%ld]\n", vma->vm_start, vma->vm_end);
     vma = vma->vm_next;
   }
-  printf("\n");
+  trace_printf("\n");
   return 0;
 }
 
 int print_list_pgn(struct pgn_t *ip)
 {
-  printf("print_list_pgn: ");
-  if (ip == NULL) { printf("NULL list\n"); return -1; }
-  printf("\n");
+  trace_printf("print_list_pgn: ");
+  if (ip == NULL) { trace_printf("NULL list\n"); return -1; }
+  trace_printf("\n");
   while (ip != NULL)
   {
-    printf("va[%d]-\n", ip->pgn);
+    trace_printf("va[%d]-\n", ip->pgn);
     ip = ip->pg_next;
   }
-  printf("n");
+  trace_printf("n");
   return 0;
 }
 
@@ -433,13 +454,13 @@ int print_pgtbl(struct pcb_t *caller, uint32_t start, uint32_t end)
   pgn_start = PAGING_PGN(start);
   pgn_end = PAGING_PGN(end);
 
-  printf("print_pgtbl: %d - %d", start, end);
-  if (caller == NULL) { printf("NULL caller\n"); return -1;}
-  printf("\n");
+  trace_printf("print_pgtbl: %d - %d", start, end);
+  if (caller == NULL) { trace_printf("NULL caller\n"); return -1;}
+  trace_printf("\n");
 
   for (pgit = pgn_start; pgit < pgn_end; pgit++)
   {
-    printf("%08ld: %08x\n", pgit * sizeof(uint32_t), caller->mm->pgd[pgit]);
+    trace_printf("%08ld: %08x\n", pgit * sizeof(uint32_t), caller->mm->pgd[pgit]);
   }
 
   return 0;
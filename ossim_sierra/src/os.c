@@ -4,6 +4,9 @@
 #include "sched.h"
 #include "loader.h"
 #include "mm.h"
+#include "stats.h"
+#include "trace.h"
+#include "event.h"
 
 #include <pthread.h>
 #include <stdio.h>
@@ -13,6 +16,17 @@
 static int time_slot;
 static int num_cpus;
 static int done = 0;
+static enum rq_mode_t rq_mode = RQ_GLOBAL;
+static const struct sched_ops_t * sched_ops = NULL;
+static char stats_path[100] = "";
+/* Binary event trace, "trace <path>" */
+static char event_path[100] = "";
+/* Report the performance counters of the processes, "perf on" */
+static int perf_report = 0;
+/* Slots a CPU may run out of the barrier, see run_ahead() */
+static int sync_quantum = 1;
+/* Threaded engine in the order of the single-threaded one, "os -d" */
+static int ordered = 0;
 
 #ifdef MM_PAGING
 static int memramsz;
@@ -41,105 +55,497 @@ int num_processes;
 struct cpu_args {
 	struct timer_id_t * timer_id;
 	int id;
+	/* State carried between two slots */
+	struct pcb_t * proc;
+	int time_left;
 };
 
+enum step_status {
+	STEP_RUN,	/* Worked in this slot, continue in the next one */
+	STEP_IDLE,	/* Nothing to do until a process is queued */
+	STEP_WAIT,	/* Nothing to do until the next arrival */
+	STEP_STOP	/* No more work, ever */
+};
 
-static void * cpu_routine(void * args) {
-	struct timer_id_t * timer_id = ((struct cpu_args*)args)->timer_id;
-	int id = ((struct cpu_args*)args)->id;
-	/* Check for new process in ready queue */
-	int time_left = 0;
-	struct pcb_t * proc = NULL;
-	while (1) {
-		/* Check the status of current process */
-		if (proc == NULL) {
-			/* No process is running, the we load new process from
-		 	* ready queue */
-			proc = get_proc();
-			if (proc == NULL) {
-                           next_slot(timer_id);
-                           continue; /* First load failed. skip dummy load */
-                        }
-		}else if (proc->pc == proc->code->size) {
-			/* The porcess has finish it job */
-			printf("\tCPU %d: Processed %2d has finished\n",
-				id ,proc->pid);
-			free(proc);
-			proc = get_proc();
-			time_left = 0;
-		}else if (time_left == 0) {
-			/* The process has done its job in current time slot */
-			printf("\tCPU %d: Put process %2d to run queue\n",
-				id, proc->pid);
-			put_proc(proc);
-			proc = get_proc();
+/* Whether the slot of the CPU touches state shared with the other
+ * devices: the run queues, or memory and syscalls for every instruction
+ * but CALC */
+static int step_shared(struct cpu_args * cpu) {
+	struct pcb_t * proc = cpu->proc;
+	return proc == NULL || proc->pc == proc->code->size ||
+		cpu->time_left == 0 || calc_ahead(proc) == 0;
+}
+
+/* Run one time slot of a CPU */
+static enum step_status cpu_step(struct cpu_args * cpu) {
+	int id = cpu->id;
+	struct pcb_t * proc = cpu->proc;
+	/* In ordered mode the loader and then the CPUs by id touch the
+	 * shared state in turn within a slot, as the single-threaded
+	 * engine does. Otherwise they race for it */
+	if (ordered && cpu->timer_id != NULL && step_shared(cpu)) {
+		wait_turn(cpu->timer_id);
+	}
+	/* Check the status of current process */
+	if (proc == NULL) {
+		/* No process is running, the we load new process from
+		 * ready queue */
+		proc = get_proc(id);
+		if (proc == NULL && !done) {
+			return STEP_IDLE; /* First load failed. sleep until a process arrives */
 		}
-		
-		/* Recheck process status after loading new process */
-		if (proc == NULL && done) {
-			/* No process to run, exit */
-			printf("\tCPU %d stopped\n", id);
-			break;
-		}else if (proc == NULL) {
-			/* There may be new processes to run in
-			 * next time slots, just skip current slot */
-			next_slot(timer_id);
-			continue;
-		}else if (time_left == 0) {
-			printf("\tCPU %d: Dispatched process %2d\n",
-				id, proc->pid);
-			time_left = time_slot;
+	}else if (proc->pc == proc->code->size) {
+		/* The porcess has finish it job */
+		TRACE_EVENT(TRACE_SCHED, EV_FINISH, proc->pid, (id),
+			"\tCPU %d: Processed %2d has finished\n", id, proc->pid);
+		if (perf_report) {
+			stats_print_perf(id, proc);
+		}
+		finish_proc(proc);
+		unload(proc);
+		free(proc);
+		proc = get_proc(id);
+		cpu->time_left = 0;
+	}else if (cpu->time_left == 0) {
+		/* The process has done its job in current time slot */
+		TRACE_EVENT(TRACE_SCHED, EV_PREEMPT, proc->pid, (id),
+			"\tCPU %d: Put process %2d to run queue\n", id, proc->pid);
+		put_proc(proc, id);
+		proc = get_proc(id);
+	}
+	cpu->proc = proc;
+
+	/* Recheck process status after loading new process */
+	if (proc == NULL && done) {
+		/* No process to run, exit */
+		TRACE_EVENT(TRACE_SCHED, EV_CPU_STOP, 0, (id),
+			"\tCPU %d stopped\n", id);
+		return STEP_STOP;
+	}else if (proc == NULL) {
+		/* There may be new processes to run in
+		 * next time slots, sleep until one is queued */
+		return STEP_IDLE;
+	}else if (cpu->time_left == 0) {
+		TRACE_EVENT(TRACE_SCHED, EV_DISPATCH, proc->pid, (id),
+			"\tCPU %d: Dispatched process %2d\n", id, proc->pid);
+		cpu->time_left = time_slot;
+	}
+
+	/* Run current process */
+	run(proc);
+	sched_tick(proc, id, 1);
+	cpu->time_left--;
+	return STEP_RUN;
+}
+
+/* Number of slots after the current one in which the CPU would only run
+ * CALC instructions of its current process: no output, no shared state */
+static uint64_t calc_slots(struct cpu_args * cpu) {
+	uint32_t n = calc_ahead(cpu->proc);
+	return (n < cpu->time_left) ? n : cpu->time_left;
+}
+
+/* Do the work of the next [slots] slots, at most calc_slots(), at once */
+static void run_slots(struct cpu_args * cpu, uint64_t slots) {
+	if (slots == 0) {
+		return;
+	}
+	run_calc(cpu->proc, slots);
+	sched_tick(cpu->proc, cpu->id, slots);
+	cpu->time_left -= slots;
+}
+
+/* Finish the current slot. Up to the next edge of the synchronization
+ * quantum, the following slots which would only run CALC instructions
+ * of the current process touch no shared state: run them out of the
+ * barrier and meet the other devices again after them */
+static void run_ahead(struct cpu_args * cpu) {
+	uint64_t time = current_time() + 1;
+	uint64_t edge = (current_time() / sync_quantum + 1) * sync_quantum;
+	uint64_t slots = calc_slots(cpu);
+
+	if (slots > edge - time) {
+		slots = edge - time;
+	}
+	leave_until(cpu->timer_id, time + slots);
+	run_slots(cpu, slots);
+	rejoin_slot(cpu->timer_id);
+}
+
+static void * cpu_routine(void * args) {
+	struct cpu_args * cpu = (struct cpu_args*)args;
+	struct timer_id_t * timer_id = cpu->timer_id;
+	enum step_status status;
+	trace_attach(TRACE_CPU + cpu->id);
+	while ((status = cpu_step(cpu)) != STEP_STOP) {
+		if (status == STEP_IDLE) {
+			park_slot(timer_id);
+		}else{
+			run_ahead(cpu);
 		}
-		
-		/* Run current process */
-		run(proc);
-		time_left--;
-		next_slot(timer_id);
 	}
 	detach_event(timer_id);
 	pthread_exit(NULL);
 }
 
-static void * ld_routine(void * args) {
+/* Arrival events, a binary min-heap ordered by arrival time and then by
+ * position in the config, so the config needs not be sorted */
+struct arrival_t {
+	unsigned long time;
+	int index;		/* Process in ld_processes */
+};
+
+struct arrival_heap_t {
+	struct arrival_t * ev;
+	int size;
+};
+
+static int arrival_before(struct arrival_t * a, struct arrival_t * b) {
+	return a->time < b->time || (a->time == b->time && a->index < b->index);
+}
+
+static void arrival_push(struct arrival_heap_t * heap, struct arrival_t ev) {
+	int i = heap->size++;
+	while (i > 0 && arrival_before(&ev, &heap->ev[(i - 1) / 2])) {
+		heap->ev[i] = heap->ev[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	heap->ev[i] = ev;
+}
+
+static struct arrival_t arrival_pop(struct arrival_heap_t * heap) {
+	struct arrival_t top = heap->ev[0];
+	struct arrival_t last = heap->ev[--heap->size];
+	int i = 0, child;
+	while ((child = 2 * i + 1) < heap->size) {
+		if (child + 1 < heap->size &&
+				arrival_before(&heap->ev[child + 1], &heap->ev[child])) {
+			child++;
+		}
+		if (!arrival_before(&heap->ev[child], &last)) {
+			break;
+		}
+		heap->ev[i] = heap->ev[child];
+		i = child;
+	}
+	heap->ev[i] = last;
+	return top;
+}
+
+/* Arrivals the loader has yet to admit, only touched by the loader */
+static struct arrival_heap_t ld_arrivals;
+/* PIDs are handed out at admission, in arrival order */
+static uint32_t ld_pid = 0;
+
+/* Processes are loaded and their memory set up ahead of their arrival by
+ * a pool of workers, off the simulated timeline. At its arrival slot the
+ * loader only admits the prepared PCB, waiting for it if the workers are
+ * behind. The single-threaded engine starts no worker and prepares each
+ * process at its arrival */
+#define LD_WORKERS 2
+
+static pthread_t ld_workers[LD_WORKERS];
+static int nr_ld_workers = 0;
+/* Arrivals no worker has taken yet, under ld_lock */
+static struct arrival_heap_t ld_pending;
+static struct pcb_t ** ld_ready;
+static pthread_mutex_t ld_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ld_cond = PTHREAD_COND_INITIALIZER;
+
+static void init_arrivals(void) {
+	int i;
+	ld_arrivals.ev = (struct arrival_t*)
+		malloc(sizeof(struct arrival_t) * num_processes);
+	ld_arrivals.size = 0;
+	for (i = 0; i < num_processes; i++) {
+		struct arrival_t ev = { ld_processes.start_time[i], i };
+		arrival_push(&ld_arrivals, ev);
+	}
+	ld_pending.ev = (struct arrival_t*)
+		malloc(sizeof(struct arrival_t) * num_processes);
+	ld_pending.size = ld_arrivals.size;
+	memcpy(ld_pending.ev, ld_arrivals.ev,
+		sizeof(struct arrival_t) * num_processes);
+	ld_ready = (struct pcb_t**)calloc(num_processes, sizeof(struct pcb_t*));
+}
+
+/* Time of the next arrival, UINT64_MAX if there is none */
+static uint64_t next_arrival(void) {
+	return ld_arrivals.size ? ld_arrivals.ev[0].time : UINT64_MAX;
+}
+
+/* Load the [i]th process of the config and set up its memory */
+static struct pcb_t * ld_prepare(int i, void * args) {
 #ifdef MM_PAGING
 	struct memphy_struct* mram = ((struct mmpaging_ld_args *)args)->mram;
 	struct memphy_struct** mswp = ((struct mmpaging_ld_args *)args)->mswp;
 	struct memphy_struct* active_mswp = ((struct mmpaging_ld_args *)args)->active_mswp;
-	struct timer_id_t * timer_id = ((struct mmpaging_ld_args *)args)->timer_id;
-#else
-	struct timer_id_t * timer_id = (struct timer_id_t*)args;
 #endif
-	int i = 0;
-	printf("ld_routine\n");
-	while (i < num_processes) {
-		struct pcb_t * proc = load(ld_processes.path[i]);
+	struct pcb_t * proc = load(ld_processes.path[i]);
 #ifdef MLQ_SCHED
-		proc->prio = ld_processes.prio[i];
+	proc->prio = ld_processes.prio[i];
 #endif
-		while (current_time() < ld_processes.start_time[i]) {
-			next_slot(timer_id);
-		}
 #ifdef MM_PAGING
-		proc->mm = malloc(sizeof(struct mm_struct));
-		init_mm(proc->mm, proc);
-		proc->mram = mram;
-		proc->mswp = mswp;
-		proc->active_mswp = active_mswp;
+	proc->mm = malloc(sizeof(struct mm_struct));
+	init_mm(proc->mm, proc);
+	proc->mram = mram;
+	proc->mswp = mswp;
+	proc->active_mswp = active_mswp;
 #endif
-		printf("\tLoaded a process at %s, PID: %d PRIO: %ld\n",
+	return proc;
+}
+
+static void * ld_worker(void * args) {
+	struct pcb_t * proc;
+	struct arrival_t ev;
+	while (1) {
+		pthread_mutex_lock(&ld_lock);
+		if (ld_pending.size == 0) {
+			pthread_mutex_unlock(&ld_lock);
+			break;
+		}
+		ev = arrival_pop(&ld_pending);
+		pthread_mutex_unlock(&ld_lock);
+
+		proc = ld_prepare(ev.index, args);
+		pthread_mutex_lock(&ld_lock);
+		ld_ready[ev.index] = proc;
+		pthread_cond_broadcast(&ld_cond);
+		pthread_mutex_unlock(&ld_lock);
+	}
+	return NULL;
+}
+
+static void start_ld_workers(void * args) {
+	int i;
+	for (i = 0; i < LD_WORKERS && i < num_processes; i++) {
+		pthread_create(&ld_workers[i], NULL, ld_worker, args);
+	}
+	nr_ld_workers = i;
+}
+
+static void stop_ld_workers(void) {
+	int i;
+	for (i = 0; i < nr_ld_workers; i++) {
+		pthread_join(ld_workers[i], NULL);
+	}
+}
+
+/* The [i]th process, ready to be admitted */
+static struct pcb_t * ld_take(int i, void * args) {
+	struct pcb_t * proc;
+	if (nr_ld_workers == 0) {
+		return ld_prepare(i, args);
+	}
+	pthread_mutex_lock(&ld_lock);
+	while ((proc = ld_ready[i]) == NULL) {
+		pthread_cond_wait(&ld_cond, &ld_lock);
+	}
+	pthread_mutex_unlock(&ld_lock);
+	return proc;
+}
+
+static void print_ld_start(void) {
+	TRACE_EVENT(TRACE_SCHED, EV_LD_START, 0, (0), "ld_routine\n");
+}
+
+/* EV_LOAD carries the program path, it does not fit TRACE_EVENT */
+static void print_load(struct pcb_t * proc, int i) {
+	if (TRACE_ON(TRACE_SCHED) && event_on) {
+		int32_t arg[EVENT_NARGS] = {ld_processes.prio[i]};
+		event_emit(EV_LOAD, proc->pid, arg, ld_processes.path[i],
+			strlen(ld_processes.path[i]) + 1);
+	}else if (TRACE_ON(TRACE_SCHED)) {
+		trace_printf("\tLoaded a process at %s, PID: %d PRIO: %ld\n",
 			ld_processes.path[i], proc->pid, ld_processes.prio[i]);
+	}
+}
+
+/* Run one time slot of the loader, admitting every process due */
+static enum step_status ld_step(void * args) {
+	struct arrival_t ev;
+	struct pcb_t * proc;
+	if (ld_arrivals.size == 0) {
+		done = 1;
+		return STEP_STOP;
+	}
+	if (current_time() < next_arrival()) {
+		return STEP_WAIT;
+	}
+	while (ld_arrivals.size > 0 && next_arrival() <= current_time()) {
+		ev = arrival_pop(&ld_arrivals);
+		proc = ld_take(ev.index, args);
+		proc->pid = ++ld_pid;
+		print_load(proc, ev.index);
 		add_proc(proc);
-		free(ld_processes.path[i]);
-		i++;
-		next_slot(timer_id);
 	}
-	free(ld_processes.path);
-	free(ld_processes.start_time);
-	done = 1;
+	return STEP_RUN;
+}
+
+static void * ld_routine(void * args) {
+#ifdef MM_PAGING
+	struct timer_id_t * timer_id = ((struct mmpaging_ld_args *)args)->timer_id;
+#else
+	struct timer_id_t * timer_id = (struct timer_id_t*)args;
+#endif
+	enum step_status status;
+	trace_attach(TRACE_LOADER);
+	print_ld_start();
+	while ((status = ld_step(args)) != STEP_STOP) {
+		if (status == STEP_WAIT) {
+			sleep_until(timer_id, next_arrival());
+		}else{
+			next_slot(timer_id);
+		}
+	}
+	/* Parked CPUs have to see [done] to stop */
+	wake_parked();
 	detach_event(timer_id);
 	pthread_exit(NULL);
 }
 
+/* Single-threaded engine: the loader and then every CPU in turn run
+ * their slot from this thread, so nothing is synchronized. It is the
+ * order wait_turn() gives the threaded engine under "os -d", and an
+ * idle CPU stays parked as park_slot() does: it resumes in the slot
+ * after the first wake up following its own step. The slots in which nothing but CALC
+ * instructions can run are done in one go and the clock jumps over
+ * them: no arrival is due, no CPU wakes up and no busy CPU leaves its
+ * current CALC run */
+static void run_serial(struct cpu_args * cpus, void * ld_args) {
+	enum step_status ld_status = STEP_RUN;
+	enum step_status * status = (enum step_status*)
+		calloc(num_cpus, sizeof(enum step_status));
+	/* wake_count() when each idle CPU parked */
+	unsigned long * seen = (unsigned long*)
+		calloc(num_cpus, sizeof(unsigned long));
+	int nr_stopped = 0;
+	int i;
+
+	print_slot();
+	print_ld_start();
+	while (1) {
+		uint64_t next = current_time() + 1;
+		uint64_t skip = UINT64_MAX;
+
+		if (ld_status != STEP_STOP) {
+			ld_status = ld_step(ld_args);
+			if (ld_status == STEP_STOP) {
+				/* Parked CPUs have to see [done] to stop */
+				wake_parked();
+			}
+		}
+		for (i = 0; i < num_cpus; i++) {
+			if (status[i] == STEP_STOP || status[i] == STEP_IDLE) {
+				continue;
+			}
+			switch (status[i] = cpu_step(&cpus[i])) {
+			case STEP_STOP:
+				nr_stopped++;
+				break;
+			case STEP_IDLE:
+				seen[i] = wake_count();
+				break;
+			default:
+				if (calc_slots(&cpus[i]) < skip) {
+					skip = calc_slots(&cpus[i]);
+				}
+			}
+		}
+		if (ld_status == STEP_STOP && nr_stopped == num_cpus) {
+			break;
+		}
+		for (i = 0; i < num_cpus; i++) {
+			if (status[i] == STEP_IDLE && seen[i] != wake_count()) {
+				/* Woken up, poll the next slot */
+				status[i] = STEP_RUN;
+				skip = 0;
+			}
+		}
+
+		if (ld_status != STEP_STOP) {
+			uint64_t arrival = next_arrival();
+			if (arrival != UINT64_MAX && arrival > next) {
+				if (arrival - next < skip) {
+					skip = arrival - next;
+				}
+			}else{
+				skip = 0;
+			}
+		}
+		if (skip == UINT64_MAX) {
+			skip = 0;
+		}
+		for (i = 0; i < num_cpus && skip > 0; i++) {
+			if (status[i] == STEP_RUN) {
+				run_slots(&cpus[i], skip);
+			}
+		}
+		advance_time(next + skip);
+		print_slot();
+	}
+	free(status);
+	free(seen);
+}
+
+/* Optional "key value" lines following the process list, e.g.
+ *	sched cfs
+ *	rq percpu
+ *	stats output/latency.json
+ *	trace output/events.bin
+ *	log -memdump,-pgtbl
+ *	perf on
+ *	quantum 16
+ * Parsing stops at the first unknown key, so legacy config files
+ * carrying extra tokens keep their old behaviour
+ */
+static void read_options(FILE * file) {
+	char key[32];
+	char val[100];
+	while (fscanf(file, "%31s %99s", key, val) == 2) {
+		if (!strcmp(key, "sched")) {
+			if ((sched_ops = find_sched_ops(val)) == NULL) {
+				printf("Unknown scheduling policy '%s'\n", val);
+				exit(1);
+			}
+		}else if (!strcmp(key, "rq")) {
+			if (!strcmp(val, "global")) {
+				rq_mode = RQ_GLOBAL;
+			}else if (!strcmp(val, "percpu")) {
+				rq_mode = RQ_PERCPU;
+			}else{
+				printf("Unknown run queue mode '%s'\n", val);
+				exit(1);
+			}
+		}else if (!strcmp(key, "quantum")) {
+			if ((sync_quantum = atoi(val)) < 1) {
+				printf("Invalid synchronization quantum '%s'\n", val);
+				exit(1);
+			}
+		}else if (!strcmp(key, "stats")) {
+			snprintf(stats_path, sizeof(stats_path), "%s", val);
+		}else if (!strcmp(key, "trace")) {
+			snprintf(event_path, sizeof(event_path), "%s", val);
+		}else if (!strcmp(key, "log")) {
+			if (trace_parse(val) != 0) {
+				printf("Unknown trace categories '%s'\n", val);
+				exit(1);
+			}
+		}else if (!strcmp(key, "perf")) {
+			if (!strcmp(val, "on")) {
+				perf_report = 1;
+			}else if (!strcmp(val, "off")) {
+				perf_report = 0;
+			}else{
+				printf("Unknown perf mode '%s'\n", val);
+				exit(1);
+			}
+		}else{
+			break;
+		}
+	}
+}
+
 static void read_config(const char * path) {
 	FILE * file;
 	if ((file = fopen(path, "r")) == NULL) {
@@ -192,12 +598,52 @@ static void read_config(const char * path) {
 #endif
 		strcat(ld_processes.path[i], proc);
 	}
+	init_arrivals();
+
+	read_options(file);
+	fclose(file);
+}
+
+static void free_ld_processes(void) {
+	int i;
+	for (i = 0; i < num_processes; i++) {
+		free(ld_processes.path[i]);
+	}
+	free(ld_processes.path);
+	free(ld_processes.start_time);
+#ifdef MLQ_SCHED
+	free(ld_processes.prio);
+#endif
+	free(ld_ready);
+	free(ld_arrivals.ev);
+	free(ld_pending.ev);
 }
 
 int main(int argc, char * argv[]) {
 	/* Read config */
+	int serial = 0;
+	const char * log_spec = NULL;
+	while (argc > 2 && argv[1][0] == '-') {
+		if (!strcmp(argv[1], "-s")) {
+			/* Single-threaded engine */
+			serial = 1;
+		}else if (!strcmp(argv[1], "-d")) {
+			/* Threaded engine printing what "-s" prints */
+			ordered = 1;
+		}else if (!strcmp(argv[1], "-l") && argc > 3) {
+			/* Trace categories, over the config ones */
+			log_spec = argv[2];
+			argc--;
+			argv++;
+		}else{
+			break;
+		}
+		argc--;
+		argv++;
+	}
 	if (argc != 2) {
-		printf("Usage: os [path to configure file]\n");
+		printf("Usage: os [-s|-d] [-l level|categories] "
+			"[path to configure file]\n");
 		return 1;
 	}
 	char path[100];
@@ -205,20 +651,44 @@ int main(int argc, char * argv[]) {
 	strcat(path, "input/");
 	strcat(path, argv[1]);
 	read_config(path);
+	if (log_spec != NULL && trace_parse(log_spec) != 0) {
+		printf("Unknown trace categories '%s'\n", log_spec);
+		return 1;
+	}
+	if (event_path[0] != '\0' && event_open(event_path) != 0) {
+		printf("Cannot write trace to %s\n", event_path);
+		return 1;
+	}
+#ifdef MM_PAGING
+	/* Devices first, the trace writer does not order these */
+	if (event_on) {
+		int sit;
+		EVENT(EV_MEMPHY, 0, 0, memramsz);
+		for (sit = 0; sit < PAGING_MAX_MMSWP; sit++)
+			EVENT(EV_MEMPHY, 0, sit + 1, memswpsz[sit]);
+	}
+#endif
 
 	pthread_t * cpu = (pthread_t*)malloc(num_cpus * sizeof(pthread_t));
 	struct cpu_args * args =
 		(struct cpu_args*)malloc(sizeof(struct cpu_args) * num_cpus);
 	pthread_t ld;
 	
-	/* Init timer */
+	/* Init timer, the single-threaded engine drives the clock itself.
+	 * The loader is attached first, it takes its turn before the CPUs */
+	struct timer_id_t * ld_event = serial ? NULL : attach_event();
 	int i;
 	for (i = 0; i < num_cpus; i++) {
-		args[i].timer_id = attach_event();
+		args[i].timer_id = serial ? NULL : attach_event();
 		args[i].id = i;
+		args[i].proc = NULL;
+		args[i].time_left = 0;
+	}
+	if (!serial) {
+		/* Threads log through the trace writer, in timeline order */
+		trace_start();
+		start_timer();
 	}
-	struct timer_id_t * ld_event = attach_event();
-	start_timer();
 
 #ifdef MM_PAGING
 	/* Init all MEMPHY include 1 MEMRAM and n of MEMSWP */
@@ -229,11 +699,14 @@ int main(int argc, char * argv[]) {
 
 	/* Create MEM RAM */
 	init_memphy(&mram, memramsz, rdmflag);
+	mram.id = 0;
 
         /* Create all MEM SWAP */ 
 	int sit;
-	for(sit = 0; sit < PAGING_MAX_MMSWP; sit++)
+	for(sit = 0; sit < PAGING_MAX_MMSWP; sit++) {
 	       init_memphy(&mswp[sit], memswpsz[sit], rdmflag);
+	       mswp[sit].id = sit + 1;
+	}
 
 	/* In Paging mode, it needs passing the system mem to each PCB through loader*/
 	struct mmpaging_ld_args *mm_ld_args = malloc(sizeof(struct mmpaging_ld_args));
@@ -246,27 +719,47 @@ int main(int argc, char * argv[]) {
 #endif
 
 	/* Init scheduler */
-	init_scheduler();
+	stats_init();
+	init_scheduler(sched_ops, num_cpus, rq_mode);
 
 	/* Run CPU and loader */
 #ifdef MM_PAGING
-	pthread_create(&ld, NULL, ld_routine, (void*)mm_ld_args);
+	void * ld_args = (void*)mm_ld_args;
 #else
-	pthread_create(&ld, NULL, ld_routine, (void*)ld_event);
+	void * ld_args = (void*)ld_event;
 #endif
-	for (i = 0; i < num_cpus; i++) {
-		pthread_create(&cpu[i], NULL,
-			cpu_routine, (void*)&args[i]);
-	}
+	if (serial) {
+		run_serial(args, ld_args);
+	}else{
+		start_ld_workers(ld_args);
+		pthread_create(&ld, NULL, ld_routine, ld_args);
+		for (i = 0; i < num_cpus; i++) {
+			pthread_create(&cpu[i], NULL,
+				cpu_routine, (void*)&args[i]);
+		}
 
-	/* Wait for CPU and loader finishing */
-	for (i = 0; i < num_cpus; i++) {
-		pthread_join(cpu[i], NULL);
+		/* Wait for CPU and loader finishing */
+		for (i = 0; i < num_cpus; i++) {
+			pthread_join(cpu[i], NULL);
+		}
+		pthread_join(ld, NULL);
+		stop_ld_workers();
+
+		/* Stop timer */
+		stop_timer();
 	}
-	pthread_join(ld, NULL);
 
-	/* Stop timer */
-	stop_timer();
+	finish_scheduler();
+	flush_images();
+	free_ld_processes();
+
+	if (stats_path[0] != '\0')
+		stats_dump(stats_path);
+	if (perf_report)
+		stats_perf_table();
+	stats_finish();
+	trace_stop();
+	event_close();
 
 	return 0;
 
@@ -0,0 +1,69 @@
+
+/* Program compiler: writes the compiled form of text programs, which
+ * load() maps in place instead of parsing them.
+ *
+ *	ossim-as program [program ...]
+ *
+ * Each program is compiled next to itself, with PROG_SUFFIX appended to
+ * its path. The loader only picks a compiled copy at least as recent as
+ * its program.
+ */
+
+#include "loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int compile(const char *path)
+{
+	struct prog_hdr_t hdr;
+	struct code_seg_t *code;
+	char bin[256], tmp[264];
+	FILE *file;
+	int ok;
+
+	code = parse_program(path, &hdr.priority);
+	hdr.magic = PROG_MAGIC;
+	hdr.version = PROG_VERSION;
+	hdr.size = code->size;
+
+	snprintf(bin, sizeof(bin), "%s%s", path, PROG_SUFFIX);
+	snprintf(tmp, sizeof(tmp), "%s.tmp", bin);
+	if ((file = fopen(tmp, "wb")) == NULL)
+	{
+		printf("ossim-as: cannot write %s\n", tmp);
+		return 1;
+	}
+	ok = fwrite(&hdr, sizeof(hdr), 1, file) == 1 &&
+		fwrite(code->text, sizeof(struct inst_t), code->size, file)
+			== code->size;
+	ok = (fclose(file) == 0) && ok;
+
+	/* Replace the old copy at once, a running simulation may map it */
+	if (!ok || rename(tmp, bin) != 0)
+	{
+		printf("ossim-as: cannot write %s\n", bin);
+		remove(tmp);
+		return 1;
+	}
+
+	free(code->text);
+	free(code->ops);
+	free(code);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int i, err = 0;
+
+	if (argc < 2)
+	{
+		printf("Usage: ossim-as program [program ...]\n");
+		return 1;
+	}
+	for (i = 1; i < argc; i++)
+		err |= compile(argv[i]);
+	return err;
+}
@@ -0,0 +1,381 @@
+
+/* Synthetic workload generator: writes a config, its programs and a
+ * script timing the simulator on them.
+ *
+ *	ossim-gen [options] name
+ *
+ *	-n N		processes (100)
+ *	-u N		distinct programs the processes are drawn from (64)
+ *	-l N		instructions per program (32)
+ *	-c N		CPUs (4)
+ *	-t N		time slice (2)
+ *	-a DIST		arrivals: poisson:RATE processes per slot (poisson:1),
+ *			uniform:SPAN slots or burst:SIZE:GAP
+ *	-p W,W,...	priority mix, weight of priority 0, 1, ... (1,1,1,1)
+ *	-i MIX		instruction mix as weights, e.g. the default
+ *			calc=60,alloc=10,free=5,read=10,write=10,syscall=5
+ *	-m N		largest allocation in bytes (256)
+ *	-r N		RAM size in bytes (1048576)
+ *	-x LINE		config option line, e.g. -x "sched cfs", repeatable
+ *	-s N		random seed (1)
+ *	-d DIR		simulator directory to write into (.)
+ *
+ * It writes DIR/input/<name>, DIR/input/proc/<name>_<k> and the script
+ * DIR/bench-<name>.sh, which runs both engines on the config. Runs are
+ * reproducible: the same options and seed give the same files.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define GEN_MAX_PRIO	140	/* MAX_PRIO of the MLQ policy */
+#define GEN_REGIONS	10	/* Region registers a program may use */
+#define GEN_SWAP_SIZE	16777216
+#define GEN_MAX_OPTS	16
+
+enum gen_op { OP_CALC, OP_ALLOC, OP_FREE, OP_READ, OP_WRITE, OP_SYSCALL,
+	NR_GEN_OPS };
+
+static const char *op_names[NR_GEN_OPS] = {
+	"calc", "alloc", "free", "read", "write", "syscall"
+};
+
+static struct {
+	long processes;
+	int programs;
+	int length;
+	int cpus;
+	int time_slice;
+	char arrival[64];
+	double prio_weights[GEN_MAX_PRIO];
+	int nr_prio;
+	double op_weights[NR_GEN_OPS];
+	int max_alloc;
+	long ram;
+	const char *opts[GEN_MAX_OPTS];
+	int nr_opts;
+	uint64_t seed;
+	const char *dir;
+	const char *name;
+} gen = {
+	.processes = 100,
+	.programs = 64,
+	.length = 32,
+	.cpus = 4,
+	.time_slice = 2,
+	.arrival = "poisson:1",
+	.prio_weights = { 1, 1, 1, 1 },
+	.nr_prio = 4,
+	.op_weights = { 60, 10, 5, 10, 10, 5 },
+	.max_alloc = 256,
+	.ram = 1048576,
+	.seed = 1,
+	.dir = ".",
+};
+
+static uint64_t rng_state;
+
+/* xorshift64*, the same stream on every host */
+static uint64_t rng(void)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 2685821657736338717ULL;
+}
+
+/* Uniform in [0, 1) */
+static double rng_unit(void)
+{
+	return (rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Uniform in [0, n) */
+static long rng_below(long n)
+{
+	return (long)(rng_unit() * n);
+}
+
+/* Index drawn from [n] weights */
+static int rng_pick(const double *weights, int n)
+{
+	double sum = 0, x;
+	int i;
+
+	for (i = 0; i < n; i++)
+		sum += weights[i];
+	x = rng_unit() * sum;
+	for (i = 0; i < n - 1; i++)
+	{
+		if (x < weights[i])
+			return i;
+		x -= weights[i];
+	}
+	return n - 1;
+}
+
+static void usage(void)
+{
+	printf("Usage: ossim-gen [-n processes] [-u programs] [-l length] "
+		"[-c cpus] [-t slice]\n"
+		"                 [-a poisson:RATE|uniform:SPAN|burst:SIZE:GAP] "
+		"[-p w,w,...]\n"
+		"                 [-i calc=W,alloc=W,free=W,read=W,write=W,"
+		"syscall=W]\n"
+		"                 [-m max alloc] [-r ram] [-x option] [-s seed] "
+		"[-d dir] name\n");
+	exit(1);
+}
+
+static void parse_prio(char *arg)
+{
+	char *tok;
+
+	gen.nr_prio = 0;
+	for (tok = strtok(arg, ","); tok != NULL; tok = strtok(NULL, ","))
+	{
+		if (gen.nr_prio == GEN_MAX_PRIO)
+			usage();
+		gen.prio_weights[gen.nr_prio++] = atof(tok);
+	}
+	if (gen.nr_prio == 0)
+		usage();
+}
+
+static void parse_mix(char *arg)
+{
+	char *tok, *val;
+	int op;
+
+	memset(gen.op_weights, 0, sizeof(gen.op_weights));
+	for (tok = strtok(arg, ","); tok != NULL; tok = strtok(NULL, ","))
+	{
+		if ((val = strchr(tok, '=')) == NULL)
+			usage();
+		*val++ = '\0';
+		for (op = 0; op < NR_GEN_OPS; op++)
+			if (!strcmp(tok, op_names[op]))
+				break;
+		if (op == NR_GEN_OPS)
+		{
+			printf("ossim-gen: unknown instruction '%s'\n", tok);
+			exit(1);
+		}
+		gen.op_weights[op] = atof(val);
+	}
+	if (gen.op_weights[OP_CALC] + gen.op_weights[OP_ALLOC] +
+		gen.op_weights[OP_FREE] + gen.op_weights[OP_READ] +
+		gen.op_weights[OP_WRITE] + gen.op_weights[OP_SYSCALL] <= 0)
+		usage();
+}
+
+static FILE *create(const char *path)
+{
+	FILE *file = fopen(path, "w");
+
+	if (file == NULL)
+	{
+		printf("ossim-gen: cannot write %s\n", path);
+		exit(1);
+	}
+	return file;
+}
+
+/* A program only touches regions it holds, within their size. An
+ * instruction which has no region to work on is a CALC instead */
+static void write_program(const char *path, int prio)
+{
+	int size[GEN_REGIONS] = { 0 };
+	int live[GEN_REGIONS];
+	int nr_live = 0, nr_free = 0;
+	int free_regs[GEN_REGIONS];
+	FILE *file = create(path);
+	int i, r, k;
+
+	fprintf(file, "%d %d\n", prio, gen.length);
+	for (i = 0; i < gen.length; i++)
+	{
+		enum gen_op op = rng_pick(gen.op_weights, NR_GEN_OPS);
+
+		nr_live = nr_free = 0;
+		for (r = 0; r < GEN_REGIONS; r++)
+		{
+			if (size[r])
+				live[nr_live++] = r;
+			else
+				free_regs[nr_free++] = r;
+		}
+		if ((op == OP_ALLOC && nr_free == 0) ||
+			(op != OP_ALLOC && op != OP_CALC &&
+			 op != OP_SYSCALL && nr_live == 0))
+			op = OP_CALC;
+
+		switch (op)
+		{
+		case OP_ALLOC:
+			r = free_regs[rng_below(nr_free)];
+			size[r] = 1 + rng_below(gen.max_alloc);
+			fprintf(file, "alloc %d %d\n", size[r], r);
+			break;
+		case OP_FREE:
+			r = live[rng_below(nr_live)];
+			size[r] = 0;
+			fprintf(file, "free %d\n", r);
+			break;
+		case OP_READ:
+			r = live[rng_below(nr_live)];
+			fprintf(file, "read %d %ld %ld\n", r,
+				rng_below(size[r]), rng_below(GEN_REGIONS));
+			break;
+		case OP_WRITE:
+			r = live[rng_below(nr_live)];
+			fprintf(file, "write %ld %d %ld\n", rng_below(256), r,
+				rng_below(size[r]));
+			break;
+		case OP_SYSCALL:
+			/* The handler which only prints its argument */
+			k = rng_below(1000);
+			fprintf(file, "syscall 440 %d 0 0\n", k);
+			break;
+		default:
+			fprintf(file, "calc\n");
+		}
+	}
+	fclose(file);
+}
+
+/* Arrival time of the [i]th process, in non decreasing order except for
+ * uniform arrivals which come in no particular order */
+static unsigned long next_arrival(long i)
+{
+	static double clock = 0;
+	double rate, span, size, gap;
+
+	if (sscanf(gen.arrival, "poisson:%lf", &rate) == 1 && rate > 0)
+	{
+		if (i > 0)
+			clock += -log(1.0 - rng_unit()) / rate;
+		return (unsigned long)clock;
+	}
+	if (sscanf(gen.arrival, "uniform:%lf", &span) == 1 && span > 0)
+		return (unsigned long)rng_below((long)span);
+	if (sscanf(gen.arrival, "burst:%lf:%lf", &size, &gap) == 2 &&
+		size >= 1 && gap >= 0)
+		return (unsigned long)(i / (long)size) * (unsigned long)gap;
+
+	printf("ossim-gen: bad arrival distribution '%s'\n", gen.arrival);
+	exit(1);
+}
+
+static void write_config(const char *path)
+{
+	FILE *file = create(path);
+	long i;
+	int k;
+
+	fprintf(file, "%d %d %ld\n", gen.time_slice, gen.cpus, gen.processes);
+	fprintf(file, "%ld %d 0 0 0\n", gen.ram, GEN_SWAP_SIZE);
+	for (i = 0; i < gen.processes; i++)
+	{
+		unsigned long time = next_arrival(i);
+
+		fprintf(file, "%lu %s_%ld %d\n", time, gen.name,
+			rng_below(gen.programs),
+			rng_pick(gen.prio_weights, gen.nr_prio));
+	}
+	for (k = 0; k < gen.nr_opts; k++)
+		fprintf(file, "%s\n", gen.opts[k]);
+	fclose(file);
+}
+
+static void write_script(const char *path)
+{
+	FILE *file = create(path);
+
+	fprintf(file,
+		"#!/bin/sh\n"
+		"# Generated by ossim-gen: %ld processes over %d programs of %d "
+		"instructions,\n"
+		"# %d CPUs, arrivals %s, seed %lu\n"
+		"#\n"
+		"# Usage: bench-%s.sh [runs]\n"
+		"# Prints one line per run: config processes engine run "
+		"milliseconds\n\n"
+		"cd \"$(dirname \"$0\")\" || exit 1\n"
+		"RUNS=${1:-3}\n"
+		"[ -x ./os ] || make os >/dev/null || exit 1\n\n"
+		"for engine in serial threaded; do\n"
+		"\tflag=\n"
+		"\t[ $engine = serial ] && flag=-s\n"
+		"\tfor run in $(seq $RUNS); do\n"
+		"\t\tstart=$(date +%%s%%N)\n"
+		"\t\t./os $flag %s >/dev/null || exit 1\n"
+		"\t\tend=$(date +%%s%%N)\n"
+		"\t\techo \"%s %ld $engine $run $(( (end - start) / 1000000 ))\"\n"
+		"\tdone\n"
+		"done\n",
+		gen.processes, gen.programs, gen.length, gen.cpus,
+		gen.arrival, (unsigned long)gen.seed, gen.name,
+		gen.name, gen.name, gen.processes);
+	fclose(file);
+	chmod(path, 0755);
+}
+
+int main(int argc, char *argv[])
+{
+	char path[512];
+	int i, opt;
+
+	while ((opt = getopt(argc, argv, "n:u:l:c:t:a:p:i:m:r:x:s:d:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': gen.processes = atol(optarg); break;
+		case 'u': gen.programs = atoi(optarg); break;
+		case 'l': gen.length = atoi(optarg); break;
+		case 'c': gen.cpus = atoi(optarg); break;
+		case 't': gen.time_slice = atoi(optarg); break;
+		case 'a':
+			snprintf(gen.arrival, sizeof(gen.arrival), "%s", optarg);
+			break;
+		case 'p': parse_prio(optarg); break;
+		case 'i': parse_mix(optarg); break;
+		case 'm': gen.max_alloc = atoi(optarg); break;
+		case 'r': gen.ram = atol(optarg); break;
+		case 'x':
+			if (gen.nr_opts == GEN_MAX_OPTS)
+				usage();
+			gen.opts[gen.nr_opts++] = optarg;
+			break;
+		case 's': gen.seed = strtoull(optarg, NULL, 0); break;
+		case 'd': gen.dir = optarg; break;
+		default: usage();
+		}
+	}
+	if (optind + 1 != argc || gen.processes < 1 || gen.programs < 1 ||
+		gen.length < 1 || gen.cpus < 1 || gen.time_slice < 1 ||
+		gen.max_alloc < 1)
+		usage();
+	gen.name = argv[optind];
+	if (gen.programs > gen.processes)
+		gen.programs = gen.processes;
+	/* xorshift never leaves 0 */
+	rng_state = gen.seed ? gen.seed : 0x9e3779b97f4a7c15ULL;
+
+	for (i = 0; i < gen.programs; i++)
+	{
+		snprintf(path, sizeof(path), "%s/input/proc/%s_%d",
+			gen.dir, gen.name, i);
+		write_program(path, rng_pick(gen.prio_weights, gen.nr_prio));
+	}
+	snprintf(path, sizeof(path), "%s/input/%s", gen.dir, gen.name);
+	write_config(path);
+	snprintf(path, sizeof(path), "%s/bench-%s.sh", gen.dir, gen.name);
+	write_script(path);
+	return 0;
+}
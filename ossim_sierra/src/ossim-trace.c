@@ -0,0 +1,567 @@
+
+/* Event trace renderer: prints the binary trace written by a run with
+ * the "trace <path>" config option.
+ *
+ *	ossim-trace [-s | -c] trace
+ *
+ * By default the events are rendered as the lines the run would have
+ * printed without the trace, the memory dumps included: the physical
+ * memory is rebuilt from the stores, fills, moves and page copies of
+ * the trace. With -s, per-process counts are printed instead. With -c,
+ * the timeline is exported as Chrome trace JSON, for chrome://tracing
+ * or ui.perfetto.dev: a track per CPU with the process run in each
+ * slot, page faults and swaps as instant events, and a counter of the
+ * free frames of each memory device. It needs the sched category.
+ */
+
+#include "event.h"
+#include "libmem.h"
+#include "mm.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NR_DEVS (PAGING_MAX_MMSWP + 1)
+#define RULE "================================================================\n"
+
+/* Length of a time slot on the exported timeline, in microseconds */
+#define SLOT_US 1000
+
+/* Physical memory devices, RAM is device 0 */
+static BYTE *dev[NR_DEVS];
+static int dev_size[NR_DEVS];
+
+/* Counts of one process for the summary */
+struct proc_sum_t {
+	uint64_t load, finish;
+	uint32_t dispatch, preempt, syscall;
+	uint32_t alloc, free, read, write, bulk;
+	uint32_t fault, swap;
+	int32_t cpu;		// Running on CPU cpu - 1, for -c
+};
+
+/* Slice open on a CPU track, pid 0 when idle */
+struct cpu_track_t {
+	uint32_t pid;
+	uint64_t start;
+};
+
+static struct proc_sum_t *sums;
+static uint32_t nr_sums;
+
+static struct cpu_track_t *cpus;
+static int32_t nr_cpus;
+static uint64_t nr_json;
+
+static int valid(int d, int addr, int n)
+{
+	return d >= 0 && d < NR_DEVS && dev[d] != NULL && addr >= 0 &&
+		n >= 0 && addr + n <= dev_size[d];
+}
+
+static void set_dev(int d, int size)
+{
+	if (d < 0 || d >= NR_DEVS || size < 0)
+		return;
+	free(dev[d]);
+	dev[d] = calloc(size, 1);
+	dev_size[d] = (dev[d] != NULL) ? size : 0;
+}
+
+static void copy_page(int sd, int sfpn, int dd, int dfpn)
+{
+	int src = sfpn * PAGING_PAGESZ, dst = dfpn * PAGING_PAGESZ;
+
+	if (valid(sd, src, PAGING_PAGESZ) && valid(dd, dst, PAGING_PAGESZ))
+		memmove(dev[dd] + dst, dev[sd] + src, PAGING_PAGESZ);
+}
+
+/* Replay the changes of physical memory */
+static void apply(const struct event_t *ev)
+{
+	const int32_t *arg = ev->arg;
+
+	switch (ev->type)
+	{
+	case EV_MEMPHY:
+		set_dev(arg[0], arg[1]);
+		break;
+	case EV_STORE:
+		if (valid(0, arg[0], 1))
+			dev[0][arg[0]] = arg[1];
+		break;
+	case EV_FILL:
+		if (valid(0, arg[0], arg[2]))
+			memset(dev[0] + arg[0], arg[1], arg[2]);
+		break;
+	case EV_MOVE:
+		if (valid(0, arg[0], arg[2]) && valid(0, arg[1], arg[2]))
+			memmove(dev[0] + arg[0], dev[0] + arg[1], arg[2]);
+		break;
+	case EV_SWAP:
+		copy_page(arg[0], arg[1], arg[2], arg[3]);
+		break;
+	case EV_SYSCALL:
+		/* sys_memmap called by the program itself */
+		if (arg[0] == 17 && arg[1] == SYSMEM_IO_WRITE &&
+				valid(0, arg[2], 1))
+			dev[0][arg[2]] = arg[3];
+		else if (arg[0] == 17 && arg[1] == SYSMEM_SWP_OP)
+			copy_page(0, arg[2], 1, arg[3]);
+		break;
+	}
+}
+
+/* print_pgtbl() of the page table payload [tbl], [len] is rounded up
+ * to whole EV_DATA records */
+static void show_pgtbl(const uint32_t *tbl, uint32_t len)
+{
+	uint32_t i, n = len / sizeof(uint32_t);
+
+	if (n == 0)
+		return;
+	if (PAGING_PGN(tbl[0]) < n - 1)
+		n = PAGING_PGN(tbl[0]) + 1;
+	printf("print_pgtbl: %d - %d\n", 0, tbl[0]);
+	for (i = 1; i < n; i++)
+		printf("%08ld: %08x\n", (i - 1) * sizeof(uint32_t), tbl[i]);
+}
+
+/* MEMPHY_dump() of the RAM */
+static void dump_ram(void)
+{
+	int i;
+
+	printf("===== PHYSICAL MEMORY DUMP =====\n");
+	for (i = 0; i < dev_size[0]; i++)
+		if (dev[0][i] != 0)
+			printf("BYTE %08x: %d\n", i, dev[0][i]);
+	printf("===== PHYSICAL MEMORY END-DUMP =====\n");
+	printf(RULE);
+}
+
+static void render(const struct event_t *ev, const void *data, uint32_t len)
+{
+	const int32_t *arg = ev->arg;
+
+	switch (ev->type)
+	{
+	case EV_SLOT:
+		printf("Time slot %3lu\n", ev->time);
+		break;
+	case EV_LD_START:
+		printf("ld_routine\n");
+		break;
+	case EV_LOAD:
+		printf("\tLoaded a process at %.*s, PID: %d PRIO: %ld\n",
+			(int)strnlen(data, len), (const char *)data, ev->pid,
+			(long)arg[0]);
+		break;
+	case EV_DISPATCH:
+		printf("\tCPU %d: Dispatched process %2d\n", arg[0], ev->pid);
+		break;
+	case EV_PREEMPT:
+		printf("\tCPU %d: Put process %2d to run queue\n", arg[0],
+			ev->pid);
+		break;
+	case EV_FINISH:
+		printf("\tCPU %d: Processed %2d has finished\n", arg[0],
+			ev->pid);
+		break;
+	case EV_CPU_STOP:
+		printf("\tCPU %d stopped\n", arg[0]);
+		break;
+	case EV_ALLOC:
+		printf("===== PHYSICAL MEMORY AFTER ALLOCATION =====\n");
+		printf("PID=%d - Region=%d - Address=%08x - Size=%d byte\n",
+			ev->pid, arg[0], arg[1], arg[2]);
+		show_pgtbl(data, len);
+		printf("\n" RULE);
+		break;
+	case EV_FREE:
+		printf("===== PHYSICAL MEMORY AFTER DEALLOCATION =====\n");
+		printf("PID=%d - Region=%d\n", ev->pid, arg[0]);
+		show_pgtbl(data, len);
+		printf(RULE);
+		break;
+	case EV_READ:
+		printf("===== PHYSICAL MEMORY AFTER READING =====\n");
+		printf("read region=%d offset=%d value=%d\n", arg[0], arg[1],
+			arg[2]);
+		show_pgtbl(data, len);
+		if (arg[5])
+			dump_ram();
+		printf(RULE);
+		break;
+	case EV_WRITE:
+		printf("===== PHYSICAL MEMORY AFTER WRITING =====\n");
+		printf("write region=%d offset=%d value=%d\n", arg[0], arg[1],
+			arg[2]);
+		show_pgtbl(data, len);
+		if (arg[5])
+			dump_ram();
+		printf(RULE);
+		break;
+	case EV_MEMSET:
+		printf("===== PHYSICAL MEMORY AFTER MEMSET =====\n");
+		printf("memset region=%d offset=%d value=%d size=%d\n", arg[0],
+			arg[1], arg[2], arg[3]);
+		show_pgtbl(data, len);
+		if (arg[5])
+			dump_ram();
+		printf(RULE);
+		break;
+	case EV_MEMCPY:
+		printf("===== PHYSICAL MEMORY AFTER MEMCPY =====\n");
+		printf("memcpy region=%d offset=%d from region=%d offset=%d "
+			"size=%d\n", arg[0], arg[1], arg[2], arg[3], arg[4]);
+		show_pgtbl(data, len);
+		if (arg[5])
+			dump_ram();
+		printf(RULE);
+		break;
+	case EV_MEMCMP:
+		printf("===== PHYSICAL MEMORY AFTER MEMCMP =====\n");
+		printf("memcmp region=%d offset=%d region=%d offset=%d size=%d "
+			"result=%d\n", arg[0], arg[1], arg[2], arg[3], arg[4],
+			arg[5]);
+		break;
+	case EV_STORE:
+		if (!arg[2])
+			break;
+		printf("Value to write: %d\n", arg[1]);
+		printf("Pphysical address: %d\n", arg[0]);
+		if (!valid(0, arg[0], 1))
+			printf("Invalid physical address: %d\n", arg[0]);
+		break;
+	}
+}
+
+static struct proc_sum_t *get_sum(uint32_t pid)
+{
+	struct proc_sum_t *grown;
+	uint32_t n;
+
+	if (pid >= nr_sums)
+	{
+		n = (pid + 1 > 2 * nr_sums) ? pid + 1 : 2 * nr_sums;
+		if ((grown = realloc(sums, n * sizeof(*sums))) == NULL)
+			return NULL;
+		memset(grown + nr_sums, 0, (n - nr_sums) * sizeof(*sums));
+		sums = grown;
+		nr_sums = n;
+	}
+	return &sums[pid];
+}
+
+static void count(const struct event_t *ev)
+{
+	struct proc_sum_t *sum;
+
+	if (ev->pid == 0 || (sum = get_sum(ev->pid)) == NULL)
+		return;
+
+	switch (ev->type)
+	{
+	case EV_LOAD:
+		sum->load = ev->time;
+		break;
+	case EV_FINISH:
+		sum->finish = ev->time;
+		break;
+	case EV_DISPATCH:
+		sum->dispatch++;
+		break;
+	case EV_PREEMPT:
+		sum->preempt++;
+		break;
+	case EV_SYSCALL:
+		sum->syscall++;
+		break;
+	case EV_ALLOC:
+		sum->alloc++;
+		break;
+	case EV_FREE:
+		sum->free++;
+		break;
+	case EV_READ:
+		sum->read++;
+		break;
+	case EV_WRITE:
+		sum->write++;
+		break;
+	case EV_MEMSET:
+	case EV_MEMCPY:
+	case EV_MEMCMP:
+		sum->bulk++;
+		break;
+	case EV_FAULT:
+		sum->fault++;
+		break;
+	case EV_SWAP:
+		sum->swap++;
+		break;
+	}
+}
+
+static void print_summary(uint64_t end, uint64_t nr_events)
+{
+	struct proc_sum_t total;
+	uint32_t pid;
+
+	memset(&total, 0, sizeof(total));
+	printf("%5s %8s %8s %8s %8s %7s %6s %6s %6s %6s %6s %7s %6s\n",
+		"PID", "LOAD", "FINISH", "DISPATCH", "PREEMPT", "SYSCALL",
+		"ALLOC", "FREE", "READ", "WRITE", "BULK", "PGFAULT", "SWAP");
+	for (pid = 1; pid < nr_sums; pid++)
+	{
+		struct proc_sum_t *s = &sums[pid];
+
+		if (s->load == 0 && s->dispatch == 0)
+			continue;
+		printf("%5u %8lu %8lu %8u %8u %7u %6u %6u %6u %6u %6u %7u %6u\n",
+			pid, s->load, s->finish, s->dispatch, s->preempt,
+			s->syscall, s->alloc, s->free, s->read, s->write,
+			s->bulk, s->fault, s->swap);
+		total.dispatch += s->dispatch;
+		total.preempt += s->preempt;
+		total.syscall += s->syscall;
+		total.alloc += s->alloc;
+		total.free += s->free;
+		total.read += s->read;
+		total.write += s->write;
+		total.bulk += s->bulk;
+		total.fault += s->fault;
+		total.swap += s->swap;
+	}
+	printf("%5s %8s %8lu %8u %8u %7u %6u %6u %6u %6u %6u %7u %6u\n",
+		"ALL", "", end, total.dispatch, total.preempt, total.syscall,
+		total.alloc, total.free, total.read, total.write, total.bulk,
+		total.fault, total.swap);
+	printf("%lu events\n", nr_events);
+}
+
+/* The Chrome trace JSON entry [fmt], after a separator but for the
+ * first one */
+static void json(const char *fmt, ...)
+{
+	va_list ap;
+
+	printf("%s\n  ", nr_json++ ? "," : "");
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+}
+
+static struct cpu_track_t *get_cpu(int32_t cpu)
+{
+	struct cpu_track_t *grown;
+	int32_t n;
+
+	if (cpu < 0)
+		return NULL;
+	if (cpu >= nr_cpus)
+	{
+		n = (cpu + 1 > 2 * nr_cpus) ? cpu + 1 : 2 * nr_cpus;
+		if ((grown = realloc(cpus, n * sizeof(*cpus))) == NULL)
+			return NULL;
+		memset(grown + nr_cpus, 0, (n - nr_cpus) * sizeof(*cpus));
+		for (; nr_cpus < n; nr_cpus++)
+			json("{\"name\": \"thread_name\", \"ph\": \"M\", "
+				"\"pid\": 0, \"tid\": %d, \"args\": "
+				"{\"name\": \"CPU %d\"}}", nr_cpus + 1, nr_cpus);
+		cpus = grown;
+	}
+	return &cpus[cpu];
+}
+
+/* Close the slice open on [cpu] at [time] */
+static void close_slice(int32_t cpu, uint64_t time, const char *end)
+{
+	struct cpu_track_t *track = &cpus[cpu];
+
+	if (track->pid == 0)
+		return;
+	json("{\"name\": \"PID %u\", \"ph\": \"X\", \"pid\": 0, "
+		"\"tid\": %d, \"ts\": %lu, \"dur\": %lu, \"args\": "
+		"{\"pid\": %u, \"end\": \"%s\"}}", track->pid, cpu + 1,
+		track->start * SLOT_US, (time - track->start) * SLOT_US,
+		track->pid, end);
+	track->pid = 0;
+}
+
+static void frames(int32_t d, int32_t nr_free, uint64_t time)
+{
+	char name[16];
+
+	if (d == 0)
+		snprintf(name, sizeof(name), "mram");
+	else
+		snprintf(name, sizeof(name), "mswp%d", d - 1);
+	json("{\"name\": \"free frames %s\", \"ph\": \"C\", \"pid\": 0, "
+		"\"ts\": %lu, \"args\": {\"free\": %d}}", name,
+		time * SLOT_US, nr_free);
+}
+
+/* An instant event of process [pid], on the track of its CPU when it
+ * is running */
+static void instant(const char *name, uint32_t pid, uint64_t time,
+		const char *args)
+{
+	struct proc_sum_t *sum = get_sum(pid);
+
+	if (sum != NULL && sum->cpu > 0)
+		json("{\"name\": \"%s\", \"ph\": \"i\", \"s\": \"t\", "
+			"\"pid\": 0, \"tid\": %d, \"ts\": %lu, \"args\": "
+			"{\"pid\": %u%s}}", name, sum->cpu, time * SLOT_US,
+			pid, args);
+	else
+		json("{\"name\": \"%s\", \"ph\": \"i\", \"s\": \"p\", "
+			"\"pid\": 0, \"ts\": %lu, \"args\": "
+			"{\"pid\": %u%s}}", name, time * SLOT_US, pid, args);
+}
+
+static void timeline(const struct event_t *ev)
+{
+	const int32_t *arg = ev->arg;
+	struct cpu_track_t *track;
+	struct proc_sum_t *sum;
+	char args[96];
+
+	switch (ev->type)
+	{
+	case EV_DISPATCH:
+		if ((track = get_cpu(arg[0])) == NULL ||
+				(sum = get_sum(ev->pid)) == NULL)
+			break;
+		close_slice(arg[0], ev->time, "preempted");
+		track->pid = ev->pid;
+		track->start = ev->time;
+		sum->cpu = arg[0] + 1;
+		break;
+	case EV_PREEMPT:
+	case EV_FINISH:
+		if (get_cpu(arg[0]) == NULL)
+			break;
+		close_slice(arg[0], ev->time,
+			ev->type == EV_FINISH ? "finished" : "preempted");
+		if ((sum = get_sum(ev->pid)) != NULL)
+			sum->cpu = 0;
+		break;
+	case EV_FAULT:
+		snprintf(args, sizeof(args), ", \"page\": %d", arg[0]);
+		instant("page fault", ev->pid, ev->time, args);
+		break;
+	case EV_SWAP:
+		snprintf(args, sizeof(args), ", \"from\": \"%d:%d\", "
+			"\"to\": \"%d:%d\"", arg[0], arg[1], arg[2], arg[3]);
+		instant("swap", ev->pid, ev->time, args);
+		break;
+	case EV_MEMPHY:
+		if (arg[1] > 0)
+			frames(arg[0], arg[1] / PAGING_PAGESZ, 0);
+		break;
+	case EV_FRAMES:
+		frames(arg[0], arg[1], ev->time);
+		break;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct event_hdr_t hdr;
+	struct event_t ev, *more = NULL;
+	uint32_t cap = 0, i;
+	uint64_t end = 0, nr_events = 0;
+	int summary = 0, chrome = 0;
+	FILE *file;
+
+	if (argc == 3 && !strcmp(argv[1], "-s"))
+	{
+		summary = 1;
+		argv++;
+		argc--;
+	}
+	else if (argc == 3 && !strcmp(argv[1], "-c"))
+	{
+		chrome = 1;
+		argv++;
+		argc--;
+	}
+	if (argc != 2)
+	{
+		printf("Usage: ossim-trace [-s | -c] trace\n");
+		return 1;
+	}
+	if ((file = fopen(argv[1], "rb")) == NULL)
+	{
+		printf("ossim-trace: cannot open %s\n", argv[1]);
+		return 1;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, file) != 1 ||
+		hdr.magic != EVENT_MAGIC || hdr.version != EVENT_VERSION ||
+		hdr.size != sizeof(struct event_t))
+	{
+		printf("ossim-trace: %s is not an event trace\n", argv[1]);
+		fclose(file);
+		return 1;
+	}
+	if (chrome)
+	{
+		printf("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+		json("{\"name\": \"process_name\", \"ph\": \"M\", "
+			"\"pid\": 0, \"args\": {\"name\": \"ossim\"}}");
+	}
+
+	while (fread(&ev, sizeof(ev), 1, file) == 1)
+	{
+		/* The payload, in the arguments of the EV_DATA records */
+		if (ev.more > cap)
+		{
+			cap = ev.more;
+			more = realloc(more, cap * sizeof(ev));
+		}
+		if (ev.more && fread(more, sizeof(ev), ev.more, file) != ev.more)
+		{
+			printf("ossim-trace: %s is truncated\n", argv[1]);
+			break;
+		}
+		for (i = 0; i < ev.more; i++)
+			memmove((char *)more + i * sizeof(ev.arg), more[i].arg,
+				sizeof(ev.arg));
+
+		if (summary)
+		{
+			count(&ev);
+		}
+		else if (chrome)
+		{
+			timeline(&ev);
+		}
+		else
+		{
+			render(&ev, more, ev.more * sizeof(ev.arg));
+			apply(&ev);
+		}
+		end = ev.time;
+		nr_events++;
+	}
+	if (summary)
+		print_summary(end, nr_events);
+	if (chrome)
+	{
+		for (i = 0; i < (uint32_t)nr_cpus; i++)
+			close_slice(i, end, "running");
+		printf("\n]}\n");
+	}
+
+	fclose(file);
+	free(more);
+	free(sums);
+	free(cpus);
+	for (i = 0; i < NR_DEVS; i++)
+		free(dev[i]);
+	return 0;
+}
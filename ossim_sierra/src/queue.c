@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "queue.h"
+#include "trace.h"
+
+#define QUEUE_IDX(q, i) (((q)->head + (i)) % (q)->capacity)
 
 int empty(struct queue_t *q)
 {
@@ -9,16 +12,42 @@ int empty(struct queue_t *q)
         return (q->size == 0);
 }
 
+/* Double the ring buffer, unrolling it so that head is back at 0 */
+static int queue_grow(struct queue_t *q)
+{
+        int capacity = q->capacity ? 2 * q->capacity : MAX_QUEUE_SIZE;
+        struct pcb_t **proc = malloc(sizeof(struct pcb_t *) * capacity);
+
+        if (proc == NULL)
+                return -1;
+        for (int i = 0; i < q->size; i++)
+                proc[i] = q->proc[QUEUE_IDX(q, i)];
+
+        free(q->proc);
+        q->proc = proc;
+        q->head = 0;
+        q->capacity = capacity;
+        return 0;
+}
+
 void enqueue(struct queue_t *q, struct pcb_t *proc)
 {
         /* TODO: put a new process to queue [q] */
-        if(q == NULL || proc == NULL || q->size >= MAX_QUEUE_SIZE) return;
+        if (q == NULL || proc == NULL)
+                return;
+        if (q->size == q->capacity && queue_grow(q) != 0) {
+                trace_printf("enqueue: out of memory, PID %d dropped\n", proc->pid);
+                return;
+        }
+        /* Keep the queue ordered by prio, a process goes after every
+         * process of the same prio. Within one MLQ level all processes
+         * share their prio so nothing is shifted */
         int it = q->size - 1;
-        while(it >= 0 && q->proc[it]->prio > proc->prio) {
-                q->proc[it + 1] = q->proc[it];
+        while (it >= 0 && queue_at(q, it)->prio > proc->prio) {
+                q->proc[QUEUE_IDX(q, it + 1)] = q->proc[QUEUE_IDX(q, it)];
                 it--;
         }
-        q->proc[q->size] = proc;
+        q->proc[QUEUE_IDX(q, it + 1)] = proc;
         q->size++;
 }
 
@@ -28,13 +57,47 @@ struct pcb_t *dequeue(struct queue_t *q)
          * in the queue [q] and remember to remove it from q
          * */
         if (empty(q)) return NULL;
-        
-        struct pcb_t *proc = q->proc[0];
 
-        for (int i = 0; i < q->size - 1; i++) {
-                q->proc[i] = q->proc[i + 1];
-        }
+        struct pcb_t *proc = q->proc[q->head];
+
+        q->head = (q->head + 1) % q->capacity;
+        q->size--;
+        return proc;
+}
 
+struct pcb_t *queue_at(struct queue_t *q, int i)
+{
+        if (q == NULL || i < 0 || i >= q->size)
+                return NULL;
+        return q->proc[QUEUE_IDX(q, i)];
+}
+
+struct pcb_t *queue_remove_at(struct queue_t *q, int i)
+{
+        struct pcb_t *proc = queue_at(q, i);
+
+        if (proc == NULL)
+                return NULL;
+        for (; i < q->size - 1; i++)
+                q->proc[QUEUE_IDX(q, i)] = q->proc[QUEUE_IDX(q, i + 1)];
         q->size--;
         return proc;
 }
+
+int queue_remove(struct queue_t *q, struct pcb_t *proc)
+{
+        for (int i = 0; q != NULL && i < q->size; i++) {
+                if (queue_at(q, i) == proc) {
+                        queue_remove_at(q, i);
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+void queue_free(struct queue_t *q)
+{
+        free(q->proc);
+        q->proc = NULL;
+        q->head = q->size = q->capacity = 0;
+}
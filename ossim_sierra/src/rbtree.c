@@ -0,0 +1,264 @@
+/*
+ * Red-black tree
+ * Balanced search tree used to order runnable processes
+ */
+
+#include "rbtree.h"
+
+static void rb_rotate_left(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *right = node->right;
+
+	node->right = right->left;
+	if (right->left != NULL)
+		right->left->parent = node;
+	right->parent = node->parent;
+	if (node->parent == NULL)
+		root->node = right;
+	else if (node == node->parent->left)
+		node->parent->left = right;
+	else
+		node->parent->right = right;
+	right->left = node;
+	node->parent = right;
+}
+
+static void rb_rotate_right(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *left = node->left;
+
+	node->left = left->right;
+	if (left->right != NULL)
+		left->right->parent = node;
+	left->parent = node->parent;
+	if (node->parent == NULL)
+		root->node = left;
+	else if (node == node->parent->right)
+		node->parent->right = left;
+	else
+		node->parent->left = left;
+	left->right = node;
+	node->parent = left;
+}
+
+void rb_link_node(struct rb_node *node, struct rb_node *parent,
+		struct rb_node **link)
+{
+	node->parent = parent;
+	node->left = node->right = NULL;
+	node->red = 1;
+	*link = node;
+}
+
+void rb_insert_color(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *parent, *gparent, *uncle;
+
+	while ((parent = node->parent) != NULL && parent->red)
+	{
+		gparent = parent->parent;
+		if (parent == gparent->left)
+		{
+			uncle = gparent->right;
+			if (uncle != NULL && uncle->red)
+			{
+				parent->red = uncle->red = 0;
+				gparent->red = 1;
+				node = gparent;
+				continue;
+			}
+			if (node == parent->right)
+			{
+				rb_rotate_left(parent, root);
+				node = parent;
+				parent = node->parent;
+			}
+			parent->red = 0;
+			gparent->red = 1;
+			rb_rotate_right(gparent, root);
+		}
+		else
+		{
+			uncle = gparent->left;
+			if (uncle != NULL && uncle->red)
+			{
+				parent->red = uncle->red = 0;
+				gparent->red = 1;
+				node = gparent;
+				continue;
+			}
+			if (node == parent->left)
+			{
+				rb_rotate_right(parent, root);
+				node = parent;
+				parent = node->parent;
+			}
+			parent->red = 0;
+			gparent->red = 1;
+			rb_rotate_left(gparent, root);
+		}
+	}
+	root->node->red = 0;
+}
+
+/* Fix the double black at [node] (may be NULL) below [parent] */
+static void rb_erase_color(struct rb_node *node, struct rb_node *parent,
+		struct rb_root *root)
+{
+	struct rb_node *sibling;
+
+	while (node != root->node && (node == NULL || !node->red))
+	{
+		if (node == parent->left)
+		{
+			sibling = parent->right;
+			if (sibling->red)
+			{
+				sibling->red = 0;
+				parent->red = 1;
+				rb_rotate_left(parent, root);
+				sibling = parent->right;
+			}
+			if ((sibling->left == NULL || !sibling->left->red) &&
+			    (sibling->right == NULL || !sibling->right->red))
+			{
+				sibling->red = 1;
+				node = parent;
+				parent = node->parent;
+				continue;
+			}
+			if (sibling->right == NULL || !sibling->right->red)
+			{
+				sibling->left->red = 0;
+				sibling->red = 1;
+				rb_rotate_right(sibling, root);
+				sibling = parent->right;
+			}
+			sibling->red = parent->red;
+			parent->red = 0;
+			sibling->right->red = 0;
+			rb_rotate_left(parent, root);
+			node = root->node;
+			break;
+		}
+		else
+		{
+			sibling = parent->left;
+			if (sibling->red)
+			{
+				sibling->red = 0;
+				parent->red = 1;
+				rb_rotate_right(parent, root);
+				sibling = parent->left;
+			}
+			if ((sibling->left == NULL || !sibling->left->red) &&
+			    (sibling->right == NULL || !sibling->right->red))
+			{
+				sibling->red = 1;
+				node = parent;
+				parent = node->parent;
+				continue;
+			}
+			if (sibling->left == NULL || !sibling->left->red)
+			{
+				sibling->right->red = 0;
+				sibling->red = 1;
+				rb_rotate_left(sibling, root);
+				sibling = parent->left;
+			}
+			sibling->red = parent->red;
+			parent->red = 0;
+			sibling->left->red = 0;
+			rb_rotate_right(parent, root);
+			node = root->node;
+			break;
+		}
+	}
+	if (node != NULL)
+		node->red = 0;
+}
+
+/* Put [new] in the place of [old] in the eyes of old's parent */
+static void rb_replace_child(struct rb_node *old, struct rb_node *new,
+		struct rb_root *root)
+{
+	if (old->parent == NULL)
+		root->node = new;
+	else if (old == old->parent->left)
+		old->parent->left = new;
+	else
+		old->parent->right = new;
+	if (new != NULL)
+		new->parent = old->parent;
+}
+
+void rb_erase(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *child, *parent;
+	int red;
+
+	if (node->left == NULL || node->right == NULL)
+	{
+		child = node->left != NULL ? node->left : node->right;
+		parent = node->parent;
+		red = node->red;
+		rb_replace_child(node, child, root);
+	}
+	else
+	{
+		/* Splice out the successor and put it where node was */
+		struct rb_node *next = node->right;
+		while (next->left != NULL)
+			next = next->left;
+
+		child = next->right;
+		red = next->red;
+		if (next->parent == node)
+		{
+			parent = next;
+		}
+		else
+		{
+			parent = next->parent;
+			parent->left = child;
+			if (child != NULL)
+				child->parent = parent;
+			next->right = node->right;
+			node->right->parent = next;
+		}
+		rb_replace_child(node, next, root);
+		next->left = node->left;
+		node->left->parent = next;
+		next->red = node->red;
+	}
+
+	if (!red)
+		rb_erase_color(child, parent, root);
+}
+
+struct rb_node *rb_first(const struct rb_root *root)
+{
+	struct rb_node *node = root->node;
+
+	if (node == NULL)
+		return NULL;
+	while (node->left != NULL)
+		node = node->left;
+	return node;
+}
+
+struct rb_node *rb_next(const struct rb_node *node)
+{
+	struct rb_node *parent;
+
+	if (node->right != NULL)
+	{
+		node = node->right;
+		while (node->left != NULL)
+			node = node->left;
+		return (struct rb_node *)node;
+	}
+	while ((parent = node->parent) != NULL && node == parent->right)
+		node = parent;
+	return parent;
+}
@@ -0,0 +1,140 @@
+/*
+ * CFS-like scheduling policy
+ * Runnable processes are kept in a red-black tree ordered by virtual
+ * runtime, the leftmost one (the one which ran the least, weighted by
+ * its priority) is dispatched next
+ */
+
+#include "sched.h"
+#include "rbtree.h"
+#include <pthread.h>
+
+/* Virtual runtime charged per slot to a process of weight CFS_WEIGHT_0 */
+#define CFS_SLOT_VRUNTIME	(1 << 16)
+#define CFS_WEIGHT_0		(MAX_PRIO / 2)
+
+#ifdef MLQ_SCHED
+#define CFS_PRIO(proc)		((proc)->prio)
+#else
+#define CFS_PRIO(proc)		((proc)->priority)
+#endif
+/* Higher priority (lower prio value) weighs more and ages slower */
+#define CFS_WEIGHT(proc)	(MAX_PRIO - (CFS_PRIO(proc) % MAX_PRIO))
+
+static struct rb_root cfs_timeline;
+static struct rb_node *cfs_leftmost;	// Cached rb_first(&cfs_timeline)
+static uint64_t min_vruntime;
+static pthread_mutex_t cfs_lock;
+
+static void cfs_init(int num_cpus, enum rq_mode_t mode)
+{
+	cfs_timeline = RB_ROOT;
+	cfs_leftmost = NULL;
+	min_vruntime = 0;
+	pthread_mutex_init(&cfs_lock, NULL);
+}
+
+static void cfs_finish(void)
+{
+	pthread_mutex_destroy(&cfs_lock);
+}
+
+/* Insert [proc] by vruntime, equal keys go right so ties are FIFO.
+ * Caller holds cfs_lock */
+static void cfs_enqueue(struct pcb_t *proc)
+{
+	struct rb_node **link = &cfs_timeline.node;
+	struct rb_node *parent = NULL;
+	int leftmost = 1;
+
+	while (*link != NULL)
+	{
+		parent = *link;
+		if (proc->vruntime < rb_entry(parent, struct pcb_t, run_node)->vruntime)
+		{
+			link = &parent->left;
+		}
+		else
+		{
+			link = &parent->right;
+			leftmost = 0;
+		}
+	}
+
+	rb_link_node(&proc->run_node, parent, link);
+	rb_insert_color(&proc->run_node, &cfs_timeline);
+	if (leftmost)
+		cfs_leftmost = &proc->run_node;
+}
+
+static struct pcb_t *cfs_get(int cpu)
+{
+	struct pcb_t *proc = NULL;
+
+	pthread_mutex_lock(&cfs_lock);
+	if (cfs_leftmost != NULL)
+	{
+		proc = rb_entry(cfs_leftmost, struct pcb_t, run_node);
+		cfs_leftmost = rb_next(cfs_leftmost);
+		rb_erase(&proc->run_node, &cfs_timeline);
+		RB_CLEAR_NODE(&proc->run_node);
+		if (proc->vruntime > min_vruntime)
+			min_vruntime = proc->vruntime;
+	}
+	pthread_mutex_unlock(&cfs_lock);
+
+	return proc;
+}
+
+static void cfs_put(struct pcb_t *proc, int cpu)
+{
+	pthread_mutex_lock(&cfs_lock);
+	cfs_enqueue(proc);
+	pthread_mutex_unlock(&cfs_lock);
+}
+
+static void cfs_add(struct pcb_t *proc)
+{
+	pthread_mutex_lock(&cfs_lock);
+	/* Start at the current minimum so a newcomer neither starves the
+	 * others nor gets starved */
+	proc->vruntime = min_vruntime;
+	cfs_enqueue(proc);
+	pthread_mutex_unlock(&cfs_lock);
+}
+
+static int cfs_remove(struct pcb_t *proc)
+{
+	int ret = 1;
+
+	pthread_mutex_lock(&cfs_lock);
+	if (!RB_EMPTY_NODE(&proc->run_node))
+	{
+		if (cfs_leftmost == &proc->run_node)
+			cfs_leftmost = rb_next(cfs_leftmost);
+		rb_erase(&proc->run_node, &cfs_timeline);
+		RB_CLEAR_NODE(&proc->run_node);
+		ret = 0;
+	}
+	pthread_mutex_unlock(&cfs_lock);
+
+	return ret;
+}
+
+/* The running process is owned by its CPU, no lock needed */
+static void cfs_tick(struct pcb_t *proc, int cpu, int slots)
+{
+	proc->vruntime += (uint64_t)slots *
+		(CFS_SLOT_VRUNTIME * CFS_WEIGHT_0 / CFS_WEIGHT(proc));
+}
+
+const struct sched_ops_t cfs_sched_ops = {
+	.name	= "cfs",
+	.init	= cfs_init,
+	.finish	= cfs_finish,
+	.get	= cfs_get,
+	.put	= cfs_put,
+	.add	= cfs_add,
+	.remove	= cfs_remove,
+	.tick	= cfs_tick,
+};
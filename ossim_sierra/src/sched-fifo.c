@@ -0,0 +1,73 @@
+/*
+ * FIFO scheduling policy
+ * One ready queue shared by all CPUs, ordered by the legacy queue_t
+ * rule: by prio, first come first served among equal prios
+ */
+
+#include "queue.h"
+#include "sched.h"
+#include <pthread.h>
+
+static struct queue_t ready_queue;
+static pthread_mutex_t queue_lock;
+
+static void fifo_init(int num_cpus, enum rq_mode_t mode)
+{
+	ready_queue.size = 0;
+	pthread_mutex_init(&queue_lock, NULL);
+}
+
+static void fifo_finish(void)
+{
+	pthread_mutex_destroy(&queue_lock);
+}
+
+static struct pcb_t *fifo_get(int cpu)
+{
+	struct pcb_t *proc = NULL;
+	/*TODO: get a process from [ready_queue].
+	 * Remember to use lock to protect the queue.
+	 * */
+	pthread_mutex_lock(&queue_lock);
+	if (!empty(&ready_queue))
+	{
+		proc = dequeue(&ready_queue);
+	}
+	pthread_mutex_unlock(&queue_lock);
+	return proc;
+}
+
+static void fifo_add(struct pcb_t *proc)
+{
+	proc->ready_queue = &ready_queue;
+
+	pthread_mutex_lock(&queue_lock);
+	enqueue(&ready_queue, proc);
+	pthread_mutex_unlock(&queue_lock);
+}
+
+static void fifo_put(struct pcb_t *proc, int cpu)
+{
+	fifo_add(proc);
+}
+
+static int fifo_remove(struct pcb_t *proc)
+{
+	int ret;
+
+	pthread_mutex_lock(&queue_lock);
+	ret = queue_remove(&ready_queue, proc);
+	pthread_mutex_unlock(&queue_lock);
+	return ret;
+}
+
+const struct sched_ops_t fifo_sched_ops = {
+	.name	= "fifo",
+	.init	= fifo_init,
+	.finish	= fifo_finish,
+	.get	= fifo_get,
+	.put	= fifo_put,
+	.add	= fifo_add,
+	.remove	= fifo_remove,
+	.tick	= NULL,
+};
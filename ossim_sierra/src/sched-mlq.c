@@ -0,0 +1,355 @@
+/*
+ * MLQ scheduling policy
+ * One FIFO queue per priority level, level prio gets MAX_PRIO - prio
+ * dispatches before it has to yield to the lower levels
+ */
+
+#include "queue.h"
+#include "sched.h"
+#include "bitops.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MLQ_SCHED
+/*
+ *  MLQ run queue, one shared by all CPUs (RQ_GLOBAL) or one per CPU
+ *  (RQ_PERCPU), each one protected by its own lock
+ */
+struct mlq_rq_t {
+	pthread_mutex_t lock;
+	struct queue_t queue[MAX_PRIO];
+	int slot[MAX_PRIO];
+
+	/* Bitmap of the non-empty queue[] levels, and of the levels
+	 * whose slot budget has been drained by wrap-arounds of higher levels */
+	unsigned long long bitmap[BITS_TO_LONG_LONGS(MAX_PRIO)];
+	unsigned long long starved[BITS_TO_LONG_LONGS(MAX_PRIO)];
+
+	/* Fenwick tree counting how many times each level wrapped its budget.
+	 * slot[prio] is charged lazily with the wraps of all higher levels
+	 * instead of walking every lower level when a budget wraps */
+	int wraps[MAX_PRIO + 1];
+	int wraps_seen[MAX_PRIO];
+
+	/* Number of queued processes, read without lock by work stealing */
+	int nr_running;
+};
+
+static enum rq_mode_t rq_mode = RQ_GLOBAL;
+static struct mlq_rq_t mlq_rq;
+static struct mlq_rq_t *cpu_rq;
+static int nr_cpu_rq;
+
+static void init_mlq_rq(struct mlq_rq_t *rq)
+{
+	int i;
+
+	memset(rq->queue, 0, sizeof(rq->queue));
+	for (i = 0; i < MAX_PRIO; i++)
+	{
+		rq->slot[i] = MAX_PRIO - i;
+		rq->wraps_seen[i] = 0;
+	}
+	for (i = 0; i <= MAX_PRIO; i++)
+		rq->wraps[i] = 0;
+	for (i = 0; i < BITS_TO_LONG_LONGS(MAX_PRIO); i++)
+		rq->bitmap[i] = rq->starved[i] = 0;
+	rq->nr_running = 0;
+	pthread_mutex_init(&rq->lock, NULL);
+}
+
+static void mlq_init(int num_cpus, enum rq_mode_t mode)
+{
+	int cpu;
+
+	init_mlq_rq(&mlq_rq);
+	rq_mode = mode;
+	if (rq_mode == RQ_PERCPU)
+	{
+		nr_cpu_rq = num_cpus;
+		cpu_rq = malloc(sizeof(struct mlq_rq_t) * nr_cpu_rq);
+		for (cpu = 0; cpu < nr_cpu_rq; cpu++)
+			init_mlq_rq(&cpu_rq[cpu]);
+	}
+}
+
+static void finish_mlq_rq(struct mlq_rq_t *rq)
+{
+	int i;
+
+	for (i = 0; i < MAX_PRIO; i++)
+		queue_free(&rq->queue[i]);
+	pthread_mutex_destroy(&rq->lock);
+}
+
+static void mlq_finish(void)
+{
+	int cpu;
+
+	finish_mlq_rq(&mlq_rq);
+	for (cpu = 0; cpu < nr_cpu_rq; cpu++)
+		finish_mlq_rq(&cpu_rq[cpu]);
+	free(cpu_rq);
+	cpu_rq = NULL;
+	nr_cpu_rq = 0;
+}
+
+/*
+ *  mlq_first_prio - lowest non-empty, non-starved priority level
+ *  Return -1 if there is no such level
+ */
+static int mlq_first_prio(struct mlq_rq_t *rq)
+{
+	int i;
+
+	for (i = 0; i < BITS_TO_LONG_LONGS(MAX_PRIO); i++)
+	{
+		unsigned long long word = rq->bitmap[i] & ~rq->starved[i];
+		if (word)
+			return i * BITS_PER_LONG_LONG + __builtin_ctzll(word);
+	}
+	return -1;
+}
+
+/*
+ *  mlq_charge - apply the pending wrap-arounds of levels [0, prio)
+ *  to slot[prio], this stands for the eager decrement of every lower
+ *  priority slot each time a budget wraps
+ */
+static void mlq_charge(struct mlq_rq_t *rq, int prio)
+{
+	int wraps = 0;
+	int i;
+
+	for (i = prio; i > 0; i -= i & -i)
+		wraps += rq->wraps[i];
+
+	rq->slot[prio] -= wraps - rq->wraps_seen[prio];
+	rq->wraps_seen[prio] = wraps;
+}
+
+static void mlq_wrap(struct mlq_rq_t *rq, int prio)
+{
+	int i;
+
+	for (i = prio + 1; i <= MAX_PRIO; i += i & -i)
+		rq->wraps[i]++;
+}
+
+/*
+ *  mlq_refill - start a new round for the starved levels which still
+ *  have processes queued, once no other level is able to run. Without
+ *  it those processes would never be dispatched again
+ *  Return 0 if some level was refilled
+ */
+static int mlq_refill(struct mlq_rq_t *rq)
+{
+	int refilled = -1;
+	int i, prio;
+
+	for (i = 0; i < BITS_TO_LONG_LONGS(MAX_PRIO); i++)
+	{
+		unsigned long long word = rq->bitmap[i] & rq->starved[i];
+		while (word)
+		{
+			prio = i * BITS_PER_LONG_LONG + __builtin_ctzll(word);
+			word &= word - 1;
+
+			mlq_charge(rq, prio);
+			rq->slot[prio] = MAX_PRIO - prio;
+			rq->starved[i] &= ~BIT_ULL_MASK(prio);
+			refilled = 0;
+		}
+	}
+	return refilled;
+}
+
+/*
+ *  Stateful design for routine calling
+ *  based on the priority and our MLQ policy
+ *  We implement stateful here using transition technique
+ *  State representation   prio = 0 .. MAX_PRIO, curr_slot = 0..(MAX_PRIO - prio)
+ */
+static struct pcb_t *mlq_rq_get(struct mlq_rq_t *rq)
+{
+	struct pcb_t *proc = NULL;
+	int prio;
+	/*TODO: get a process from PRIORITY [ready_queue].
+	 * Remember to use lock to protect the queue.
+	 * */
+	pthread_mutex_lock(&rq->lock);
+	while ((prio = mlq_first_prio(rq)) >= 0 || mlq_refill(rq) == 0)
+	{
+		if (prio < 0)
+			continue;
+
+		mlq_charge(rq, prio);
+		if (rq->slot[prio] <= 0)
+		{
+			/* Budget drained by higher levels, it waits for
+			 * mlq_refill() */
+			rq->starved[BIT_ULL_WORD(prio)] |= BIT_ULL_MASK(prio);
+			continue;
+		}
+
+		proc = dequeue(&rq->queue[prio]);
+		if (empty(&rq->queue[prio]))
+			rq->bitmap[BIT_ULL_WORD(prio)] &= ~BIT_ULL_MASK(prio);
+		__atomic_sub_fetch(&rq->nr_running, 1, __ATOMIC_RELAXED);
+		rq->slot[prio]--;
+
+		if (rq->slot[prio] == 0)
+		{
+			rq->slot[prio] = MAX_PRIO - prio;
+			mlq_wrap(rq, prio);
+		}
+
+		break;
+	}
+	pthread_mutex_unlock(&rq->lock);
+
+	return proc;
+}
+
+static void mlq_rq_put(struct mlq_rq_t *rq, struct pcb_t *proc)
+{
+	proc->mlq_ready_queue = rq->queue;
+
+	pthread_mutex_lock(&rq->lock);
+	enqueue(&rq->queue[proc->prio], proc);
+	rq->bitmap[BIT_ULL_WORD(proc->prio)] |= BIT_ULL_MASK(proc->prio);
+	__atomic_add_fetch(&rq->nr_running, 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&rq->lock);
+}
+
+/*
+ *  mlq_rq_remove - take [proc] out of [rq] if it is queued there
+ *  Return 0 if it was
+ */
+static int mlq_rq_remove(struct mlq_rq_t *rq, struct pcb_t *proc)
+{
+	int prio = proc->prio;
+	int ret;
+
+	pthread_mutex_lock(&rq->lock);
+	ret = queue_remove(&rq->queue[prio], proc);
+	if (ret == 0)
+	{
+		__atomic_sub_fetch(&rq->nr_running, 1, __ATOMIC_RELAXED);
+		/* A drained budget is found again by mlq_rq_get() when
+		 * the level next has a process */
+		if (empty(&rq->queue[prio]))
+		{
+			rq->bitmap[BIT_ULL_WORD(prio)] &= ~BIT_ULL_MASK(prio);
+			rq->starved[BIT_ULL_WORD(prio)] &= ~BIT_ULL_MASK(prio);
+		}
+	}
+	pthread_mutex_unlock(&rq->lock);
+
+	return ret;
+}
+
+/*
+ *  mlq_steal - take a process from the busiest peer run queue
+ *  The load figures are sampled without locks, a stale pick just
+ *  makes mlq_rq_get() return NULL
+ */
+static struct pcb_t *mlq_steal(int cpu)
+{
+	int busiest = -1;
+	int max_load = 0;
+	int load;
+	int i;
+
+	for (i = 0; i < nr_cpu_rq; i++)
+	{
+		load = __atomic_load_n(&cpu_rq[i].nr_running, __ATOMIC_RELAXED);
+		if (i != cpu && load > max_load)
+		{
+			max_load = load;
+			busiest = i;
+		}
+	}
+
+	if (busiest < 0)
+		return NULL;
+
+	return mlq_rq_get(&cpu_rq[busiest]);
+}
+
+/* Pick the least loaded per-CPU run queue for a newly admitted process */
+static struct mlq_rq_t *mlq_idlest_rq(void)
+{
+	int idlest = 0;
+	int min_load = __atomic_load_n(&cpu_rq[0].nr_running, __ATOMIC_RELAXED);
+	int load;
+	int i;
+
+	for (i = 1; i < nr_cpu_rq; i++)
+	{
+		load = __atomic_load_n(&cpu_rq[i].nr_running, __ATOMIC_RELAXED);
+		if (load < min_load)
+		{
+			min_load = load;
+			idlest = i;
+		}
+	}
+
+	return &cpu_rq[idlest];
+}
+
+static struct pcb_t *get_mlq_proc(int cpu)
+{
+	struct pcb_t *proc;
+
+	if (rq_mode == RQ_GLOBAL)
+		return mlq_rq_get(&mlq_rq);
+
+	proc = mlq_rq_get(&cpu_rq[cpu]);
+	if (proc == NULL)
+		proc = mlq_steal(cpu);
+
+	return proc;
+}
+
+static void put_mlq_proc(struct pcb_t *proc, int cpu)
+{
+	if (rq_mode == RQ_GLOBAL)
+		mlq_rq_put(&mlq_rq, proc);
+	else /* Keep the process on the CPU which ran it */
+		mlq_rq_put(&cpu_rq[cpu], proc);
+}
+
+static void add_mlq_proc(struct pcb_t *proc)
+{
+	if (rq_mode == RQ_GLOBAL)
+		mlq_rq_put(&mlq_rq, proc);
+	else
+		mlq_rq_put(mlq_idlest_rq(), proc);
+}
+
+static int remove_mlq_proc(struct pcb_t *proc)
+{
+	int cpu;
+
+	if (rq_mode == RQ_GLOBAL)
+		return mlq_rq_remove(&mlq_rq, proc);
+
+	for (cpu = 0; cpu < nr_cpu_rq; cpu++)
+		if (mlq_rq_remove(&cpu_rq[cpu], proc) == 0)
+			return 0;
+	return 1;
+}
+
+const struct sched_ops_t mlq_sched_ops = {
+	.name	= "mlq",
+	.init	= mlq_init,
+	.finish	= mlq_finish,
+	.get	= get_mlq_proc,
+	.put	= put_mlq_proc,
+	.add	= add_mlq_proc,
+	.remove	= remove_mlq_proc,
+	.tick	= NULL,
+};
+#endif
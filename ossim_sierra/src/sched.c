@@ -1,174 +1,202 @@
+
 #include "queue.h"
 #include "sched.h"
+#include "stats.h"
+#include "timer.h"
 #include <pthread.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include <stdio.h>
-static struct queue_t ready_queue;
-static struct queue_t run_queue;
-static pthread_mutex_t queue_lock;
 
-static struct queue_t running_list;
-#ifdef MLQ_SCHED
-static struct queue_t mlq_ready_queue[MAX_PRIO];
-static int slot[MAX_PRIO];
-#endif
+static const struct sched_ops_t *sched_ops;
 
-int queue_empty(void)
-{
+/* Every policy known to the "sched" config option, the first is the
+ * default one */
+static const struct sched_ops_t *sched_policies[] = {
 #ifdef MLQ_SCHED
-	unsigned long prio;
-	for (prio = 0; prio < MAX_PRIO; prio++)
-		if (!empty(&mlq_ready_queue[prio]))
-			return -1;
+	&mlq_sched_ops,
 #endif
-	return (empty(&ready_queue) && empty(&run_queue));
-}
+	&fifo_sched_ops,
+	&cfs_sched_ops,
+	NULL
+};
 
-void init_scheduler(void)
+static struct queue_t running_list;
+static pthread_mutex_t running_lock;
+
+/* Number of processes waiting for admission or in the policy ready queues */
+static int nr_ready;
+
+/* Lock-free admission stack. add_proc() pushes new processes without
+ * taking any lock and the CPUs drain it in batches into the policy
+ * when they look for their next process */
+static struct pcb_t *admit_head;
+
+const struct sched_ops_t *find_sched_ops(const char *name)
 {
-#ifdef MLQ_SCHED
 	int i;
 
-	for (i = 0; i < MAX_PRIO; i++)
-	{
-		mlq_ready_queue[i].size = 0;
-		slot[i] = MAX_PRIO - i;
-	}
-#endif
-	ready_queue.size = 0;
-	run_queue.size = 0;
-	pthread_mutex_init(&queue_lock, NULL);
+	for (i = 0; sched_policies[i] != NULL; i++)
+		if (!strcmp(sched_policies[i]->name, name))
+			return sched_policies[i];
+	return NULL;
 }
 
-#ifdef MLQ_SCHED
-/*
- *  Stateful design for routine calling
- *  based on the priority and our MLQ policy
- *  We implement stateful here using transition technique
- *  State representation   prio = 0 .. MAX_PRIO, curr_slot = 0..(MAX_PRIO - prio)
- */
-struct pcb_t *get_mlq_proc(void)
+int queue_empty(void)
 {
-	struct pcb_t *proc = NULL;
-	int prio;
-	/*TODO: get a process from PRIORITY [ready_queue].
-	 * Remember to use lock to protect the queue.
-	 * */
-	pthread_mutex_lock(&queue_lock);
-	for(prio = 0; prio < MAX_PRIO; prio++)
-	{
-		if (!empty(&mlq_ready_queue[prio]))
-		{
-			if(slot[prio] > 0)
-			{
-				proc = dequeue(&mlq_ready_queue[prio]);
-				slot[prio]--;
-
-				if (slot[prio] == 0)
-				{
-					slot[prio] = MAX_PRIO - prio;
-					for (int i = prio + 1; i < MAX_PRIO; i++) slot[i]--;
-				}
-
-				break;
-			}
-		}
-	}
-	pthread_mutex_unlock(&queue_lock);
-
-	return proc;
+	return __atomic_load_n(&nr_ready, __ATOMIC_RELAXED) == 0;
 }
 
-void put_mlq_proc(struct pcb_t *proc)
+void init_scheduler(const struct sched_ops_t *ops,
+		int num_cpus, enum rq_mode_t mode)
 {
-	pthread_mutex_lock(&queue_lock);
-	enqueue(&mlq_ready_queue[proc->prio], proc);
-	pthread_mutex_unlock(&queue_lock);
+	sched_ops = (ops != NULL) ? ops : sched_policies[0];
+	sched_ops->init(num_cpus, mode);
+
+	nr_ready = 0;
+	admit_head = NULL;
+	running_list.size = 0;
+	pthread_mutex_init(&running_lock, NULL);
 }
 
-void add_mlq_proc(struct pcb_t *proc)
+void finish_scheduler(void)
 {
-	pthread_mutex_lock(&queue_lock);
-	enqueue(&mlq_ready_queue[proc->prio], proc);
-	pthread_mutex_unlock(&queue_lock);
+	sched_ops->finish();
+	pthread_mutex_destroy(&running_lock);
 }
 
-struct pcb_t *get_proc(void)
+/* Track the process in running_list, the list sys_killall traverses.
+ * A process is listed once when admitted and delisted by finish_proc() */
+static void enlist_running(struct pcb_t *proc)
 {
-	return get_mlq_proc();
+	pthread_mutex_lock(&running_lock);
+	enqueue(&running_list, proc);
+	pthread_mutex_unlock(&running_lock);
 }
 
-void put_proc(struct pcb_t *proc)
+void finish_proc(struct pcb_t *proc)
 {
-	proc->ready_queue = &ready_queue;
-	proc->mlq_ready_queue = mlq_ready_queue;
-	proc->running_list = &running_list;
+	proc->finish_time = current_time();
+	stats_record(proc);
 
-	/* TODO: put running proc to running_list */
+	pthread_mutex_lock(&running_lock);
+	queue_remove(&running_list, proc);
+	pthread_mutex_unlock(&running_lock);
+}
 
-	pthread_mutex_lock(&queue_lock);
-	enqueue(&running_list, proc);
-	pthread_mutex_unlock(&queue_lock);
+struct pcb_t *remove_proc(uint32_t pid)
+{
+	struct pcb_t *proc = NULL;
+	int i;
 
-	return put_mlq_proc(proc);
+	/* A listed process is not freed under running_lock: its CPU
+	 * delists it in finish_proc() first */
+	pthread_mutex_lock(&running_lock);
+	for (i = 0; i < running_list.size; i++)
+	{
+		proc = queue_at(&running_list, i);
+		if (proc->pid == pid)
+			break;
+	}
+	if (i == running_list.size || sched_ops->remove(proc) != 0)
+		proc = NULL;
+	else
+	{
+		queue_remove_at(&running_list, i);
+		__atomic_sub_fetch(&nr_ready, 1, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&running_lock);
+
+	return proc;
 }
 
-void add_proc(struct pcb_t *proc)
+/* Move every admitted process into the policy, oldest first */
+static void admit_drain(void)
 {
-	proc->ready_queue = &ready_queue;
-	proc->mlq_ready_queue = mlq_ready_queue;
-	proc->running_list = &running_list;
+	struct pcb_t *batch, *proc, *next;
+	struct pcb_t *fifo = NULL;
 
-	/* TODO: put running proc to running_list */
+	if (__atomic_load_n(&admit_head, __ATOMIC_RELAXED) == NULL)
+		return;
 
-	pthread_mutex_lock(&queue_lock);
-	enqueue(&running_list, proc);
-	pthread_mutex_unlock(&queue_lock);
+	/* Detach the whole stack at once, so concurrent drainers get
+	 * disjoint batches and there is no ABA on the head */
+	batch = __atomic_exchange_n(&admit_head, NULL, __ATOMIC_ACQUIRE);
+	for (proc = batch; proc != NULL; proc = next)
+	{
+		next = proc->admit_next;
+		proc->admit_next = fifo;
+		fifo = proc;
+	}
 
-	return add_mlq_proc(proc);
+	for (proc = fifo; proc != NULL; proc = next)
+	{
+		next = proc->admit_next;
+		enlist_running(proc);
+		sched_ops->add(proc);
+	}
 }
-#else
-struct pcb_t *get_proc(void)
+
+struct pcb_t *get_proc(int cpu)
 {
-	struct pcb_t *proc = NULL;
-	/*TODO: get a process from [ready_queue].
-	 * Remember to use lock to protect the queue.
-	 * */
-	pthread_mutex_lock(&queue_lock);
-	if (!empty(&ready_queue))
+	struct pcb_t *proc;
+
+	admit_drain();
+
+	proc = sched_ops->get(cpu);
+
+	if (proc != NULL)
 	{
-		proc = dequeue(&ready_queue);
+		uint64_t now = current_time();
+
+		__atomic_sub_fetch(&nr_ready, 1, __ATOMIC_RELAXED);
+		proc->wait_time += now - proc->ready_time;
+		if (proc->nr_dispatch++ == 0)
+			proc->first_dispatch_time = now;
 	}
-	pthread_mutex_unlock(&queue_lock);
 	return proc;
 }
 
-void put_proc(struct pcb_t *proc)
+void put_proc(struct pcb_t *proc, int cpu)
 {
-	proc->ready_queue = &ready_queue;
-	proc->running_list = &running_list;
-
-	/* TODO: put running proc to running_list */
+	proc->ready_time = current_time();
+	__atomic_add_fetch(&nr_ready, 1, __ATOMIC_RELAXED);
 
-	pthread_mutex_lock(&queue_lock);
-	enqueue(&running_list, proc);
-	pthread_mutex_unlock(&queue_lock);
+	/* Processes admitted earlier in the slot queue up ahead of it */
+	admit_drain();
+	sched_ops->put(proc, cpu);
 
-	return put_mlq_proc(proc);
+	/* Let idle CPUs compete for it (or steal it) from next slot */
+	wake_parked();
 }
 
 void add_proc(struct pcb_t *proc)
 {
-	proc->ready_queue = &ready_queue;
+	/* The policy fills in the ready queue it uses */
+	proc->ready_queue = NULL;
+#ifdef MLQ_SCHED
+	proc->mlq_ready_queue = NULL;
+#endif
 	proc->running_list = &running_list;
 
-	/* TODO: put running proc to running_list */
+	proc->arrival_time = proc->ready_time = current_time();
+	proc->first_dispatch_time = proc->finish_time = 0;
+	proc->wait_time = 0;
+	proc->nr_dispatch = 0;
 
-	pthread_mutex_lock(&queue_lock);
-	enqueue(&running_list, proc);
-	pthread_mutex_unlock(&queue_lock);
+	__atomic_add_fetch(&nr_ready, 1, __ATOMIC_RELAXED);
 
-	return add_mlq_proc(proc);
+	proc->admit_next = __atomic_load_n(&admit_head, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&admit_head, &proc->admit_next,
+			proc, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+
+	wake_parked();
+}
+
+void sched_tick(struct pcb_t *proc, int cpu, int slots)
+{
+	if (sched_ops->tick != NULL)
+		sched_ops->tick(proc, cpu, slots);
 }
-#endif
@@ -0,0 +1,284 @@
+/*
+ * Latency statistics
+ * wait       : time spent in ready queues
+ * response   : arrival to first dispatch
+ * turnaround : arrival to finish
+ *
+ * and the performance counters of the processes
+ */
+
+#include "stats.h"
+#include "syscall.h"
+#include "trace.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Histogram buckets are powers of two: <= 0, 1, 2, 4, ... 2^(N-2) slots */
+#define STATS_NR_BUCKETS 32
+
+struct stats_rec_t {
+	uint32_t pid;
+	uint32_t prio;
+	char path[100];
+	uint64_t arrival;
+	uint64_t first_dispatch;
+	uint64_t finish;
+	uint64_t wait;
+	uint32_t nr_dispatch;
+	struct perf_count_t perf;
+};
+
+static struct stats_rec_t *recs;
+static int nr_recs;
+static int max_recs;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void stats_init(void)
+{
+	recs = NULL;
+	nr_recs = max_recs = 0;
+}
+
+void stats_finish(void)
+{
+	free(recs);
+	recs = NULL;
+	nr_recs = max_recs = 0;
+}
+
+void stats_record(struct pcb_t *proc)
+{
+	struct stats_rec_t *rec;
+
+	pthread_mutex_lock(&stats_lock);
+	if (nr_recs == max_recs)
+	{
+		int cap = max_recs ? 2 * max_recs : 64;
+		struct stats_rec_t *grown = realloc(recs, sizeof(*recs) * cap);
+		if (grown == NULL)
+		{
+			pthread_mutex_unlock(&stats_lock);
+			return;
+		}
+		recs = grown;
+		max_recs = cap;
+	}
+
+	rec = &recs[nr_recs++];
+	rec->pid = proc->pid;
+#ifdef MLQ_SCHED
+	rec->prio = proc->prio;
+#else
+	rec->prio = proc->priority;
+#endif
+	snprintf(rec->path, sizeof(rec->path), "%s", proc->path);
+	rec->arrival = proc->arrival_time;
+	rec->first_dispatch = proc->first_dispatch_time;
+	rec->finish = proc->finish_time;
+	rec->wait = proc->wait_time;
+	rec->nr_dispatch = proc->nr_dispatch;
+	rec->perf = proc->perf;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+/* Name of a slot of the per-syscall counters */
+static const char *syscall_name(int slot)
+{
+	return (slot < syscall_table_size) ? sys_call_table[slot] : "other";
+}
+
+/* The non-zero per-syscall counters, as "name:count" separated by [sep],
+ * to the simulation output when [file] is NULL */
+static void print_syscalls(FILE *file, const uint32_t *syscalls,
+		const char *fmt, const char *sep)
+{
+	int i, n = 0;
+
+	for (i = 0; i < PERF_MAX_SYSCALLS; i++)
+	{
+		if (!syscalls[i])
+			continue;
+		if (file == NULL)
+			trace_printf(fmt, n++ ? sep : "", syscall_name(i),
+				syscalls[i]);
+		else
+			fprintf(file, fmt, n++ ? sep : "", syscall_name(i),
+				syscalls[i]);
+	}
+}
+
+void stats_print_perf(int cpu, struct pcb_t *proc)
+{
+	struct perf_count_t *perf = &proc->perf;
+
+	trace_printf("\tCPU %d: Process %2d perf: %lu instructions, %u allocs, "
+		"%u frees, %u page faults, %u swap in, %u swap out, "
+		"%lu slots waiting, syscalls [",
+		cpu, proc->pid, perf->instructions, perf->nr_alloc,
+		perf->nr_free, perf->page_faults, perf->swap_in,
+		perf->swap_out, proc->wait_time);
+	print_syscalls(NULL, perf->syscalls, "%s%s:%u", " ");
+	trace_printf("]\n");
+}
+
+void stats_perf_table(void)
+{
+	struct perf_count_t total;
+	uint64_t total_wait = 0;
+	int i, j;
+
+	memset(&total, 0, sizeof(total));
+
+	pthread_mutex_lock(&stats_lock);
+	trace_printf("===== PERFORMANCE COUNTERS =====\n");
+	trace_printf("%5s %12s %6s %6s %8s %7s %8s %8s  %s\n", "PID", "INSTR",
+		"ALLOC", "FREE", "PGFAULT", "SWAPIN", "SWAPOUT", "WAIT",
+		"SYSCALLS");
+	for (i = 0; i < nr_recs; i++)
+	{
+		struct perf_count_t *perf = &recs[i].perf;
+
+		trace_printf("%5u %12lu %6u %6u %8u %7u %8u %8lu  ", recs[i].pid,
+			perf->instructions, perf->nr_alloc, perf->nr_free,
+			perf->page_faults, perf->swap_in, perf->swap_out,
+			recs[i].wait);
+		print_syscalls(NULL, perf->syscalls, "%s%s:%u", " ");
+		trace_printf("\n");
+
+		total.instructions += perf->instructions;
+		total.nr_alloc += perf->nr_alloc;
+		total.nr_free += perf->nr_free;
+		total.page_faults += perf->page_faults;
+		total.swap_in += perf->swap_in;
+		total.swap_out += perf->swap_out;
+		for (j = 0; j < PERF_MAX_SYSCALLS; j++)
+			total.syscalls[j] += perf->syscalls[j];
+		total_wait += recs[i].wait;
+	}
+	trace_printf("%5s %12lu %6u %6u %8u %7u %8u %8lu  ", "ALL",
+		total.instructions, total.nr_alloc, total.nr_free,
+		total.page_faults, total.swap_in, total.swap_out, total_wait);
+	print_syscalls(NULL, total.syscalls, "%s%s:%u", " ");
+	trace_printf("\n===== PERFORMANCE COUNTERS END =====\n");
+	pthread_mutex_unlock(&stats_lock);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of the sorted [v] */
+static uint64_t percentile(const uint64_t *v, int n, int pct)
+{
+	int rank = (pct * n + 99) / 100;
+	return v[rank > 0 ? rank - 1 : 0];
+}
+
+static int bucket_of(uint64_t x)
+{
+	int b = 0;
+
+	while (x > 0 && b < STATS_NR_BUCKETS - 1)
+	{
+		b++;
+		if (x <= (1ULL << (b - 1)))
+			break;
+	}
+	return b;
+}
+
+static void dump_summary(FILE *file, const char *name, uint64_t *v, int n)
+{
+	uint64_t hist[STATS_NR_BUCKETS] = { 0 };
+	uint64_t sum = 0;
+	int i, last = 0;
+
+	fprintf(file, "    \"%s\": {\"count\": %d", name, n);
+	if (n == 0)
+	{
+		fprintf(file, "}");
+		return;
+	}
+
+	qsort(v, n, sizeof(uint64_t), cmp_u64);
+	for (i = 0; i < n; i++)
+	{
+		sum += v[i];
+		hist[bucket_of(v[i])]++;
+	}
+	fprintf(file, ", \"mean\": %.3f, \"min\": %lu, \"p50\": %lu, "
+		"\"p90\": %lu, \"p95\": %lu, \"p99\": %lu, \"max\": %lu,\n",
+		(double)sum / n, v[0],
+		percentile(v, n, 50), percentile(v, n, 90),
+		percentile(v, n, 95), percentile(v, n, 99), v[n - 1]);
+
+	for (i = 0; i < STATS_NR_BUCKETS; i++)
+		if (hist[i])
+			last = i;
+	fprintf(file, "      \"histogram\": [");
+	for (i = 0; i <= last; i++)
+		fprintf(file, "%s{\"le\": %lu, \"count\": %lu}", i ? ", " : "",
+			i ? (1UL << (i - 1)) : 0UL, hist[i]);
+	fprintf(file, "]}");
+}
+
+int stats_dump(const char *path)
+{
+	FILE *file;
+	uint64_t *wait, *response, *turnaround;
+	int i;
+
+	if ((file = fopen(path, "w")) == NULL)
+	{
+		printf("Cannot write statistics to %s\n", path);
+		return -1;
+	}
+
+	pthread_mutex_lock(&stats_lock);
+	wait = malloc(sizeof(uint64_t) * (nr_recs + 1));
+	response = malloc(sizeof(uint64_t) * (nr_recs + 1));
+	turnaround = malloc(sizeof(uint64_t) * (nr_recs + 1));
+
+	fprintf(file, "{\n  \"processes\": [\n");
+	for (i = 0; i < nr_recs; i++)
+	{
+		struct stats_rec_t *rec = &recs[i];
+
+		wait[i] = rec->wait;
+		response[i] = rec->first_dispatch - rec->arrival;
+		turnaround[i] = rec->finish - rec->arrival;
+		fprintf(file, "    {\"pid\": %u, \"path\": \"%s\", \"prio\": %u, "
+			"\"arrival\": %lu, \"first_dispatch\": %lu, \"finish\": %lu, "
+			"\"dispatches\": %u, \"wait\": %lu, \"response\": %lu, "
+			"\"turnaround\": %lu,\n     \"perf\": {\"instructions\": %lu, "
+			"\"allocs\": %u, \"frees\": %u, \"page_faults\": %u, "
+			"\"swap_in\": %u, \"swap_out\": %u, \"syscalls\": {",
+			rec->pid, rec->path, rec->prio,
+			rec->arrival, rec->first_dispatch, rec->finish,
+			rec->nr_dispatch, wait[i], response[i], turnaround[i],
+			rec->perf.instructions, rec->perf.nr_alloc,
+			rec->perf.nr_free, rec->perf.page_faults,
+			rec->perf.swap_in, rec->perf.swap_out);
+		print_syscalls(file, rec->perf.syscalls, "%s\"%s\": %u", ", ");
+		fprintf(file, "}}}%s\n", i + 1 < nr_recs ? "," : "");
+	}
+	fprintf(file, "  ],\n  \"summary\": {\n");
+	dump_summary(file, "wait", wait, nr_recs);
+	fprintf(file, ",\n");
+	dump_summary(file, "response", response, nr_recs);
+	fprintf(file, ",\n");
+	dump_summary(file, "turnaround", turnaround, nr_recs);
+	fprintf(file, "\n  }\n}\n");
+	pthread_mutex_unlock(&stats_lock);
+
+	free(wait);
+	free(response);
+	free(turnaround);
+	fclose(file);
+	return 0;
+}
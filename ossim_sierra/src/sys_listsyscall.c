@@ -9,11 +9,14 @@
  */
 
 #include "syscall.h"
+#include "trace.h"
 
 int __sys_listsyscall(struct pcb_t *caller, struct sc_regs* reg)
 {
+   if (!TRACE_ON(TRACE_SYSCALL))
+       return 0;
    for (int i = 0; i < syscall_table_size; i++)
-       printf("%s\n",sys_call_table[i]); 
+       trace_printf("%s\n",sys_call_table[i]); 
 
    return 0;
 }
@@ -11,6 +11,7 @@
 #include "syscall.h"
 #include "libmem.h"
 #include "mm.h"
+#include "trace.h"
 
 //typedef char BYTE;
 
@@ -37,7 +38,8 @@ int __sys_memmap(struct pcb_t *caller, struct sc_regs* regs)
             MEMPHY_write(caller->mram, regs->a2, regs->a3);
             break;
    default:
-            printf("Memop code: %d\n", memop);
+            if (TRACE_ON(TRACE_SYSCALL))
+                trace_printf("Memop code: %d\n", memop);
             break;
    }
    
@@ -1,9 +1,11 @@
 #include "common.h"
 #include "syscall.h"
+#include "trace.h"
 #include "stdio.h"
 
 int __sys_xxxhandler(struct pcb_t *caller, struct sc_regs* regs)
 {
-    printf("The first system call parameter %d\n", regs->a1);
+    if (TRACE_ON(TRACE_SYSCALL))
+        trace_printf("The first system call parameter %d\n", regs->a1);
     return 0;
 }
\ No newline at end of file
@@ -26,6 +26,19 @@ const char* sys_call_table[] = {
 #undef  __SYSCALL
 const int syscall_table_size = sizeof(sys_call_table)/sizeof(char*);
 
+/*
+ * Slot of each system call in the per-process counters, in the order of
+ * sys_call_table[]. Numbers missing from the table share the last one.
+ */
+#define __SYSCALL(nr, sym) PERF_SC_##sym,
+enum perf_syscall_slot {
+#include "syscalltbl.lst"
+	PERF_SC_OTHER
+};
+#undef  __SYSCALL
+_Static_assert(PERF_SC_OTHER < PERF_MAX_SYSCALLS,
+	"PERF_MAX_SYSCALLS too small for the syscall table");
+
 int __sys_ni_syscall(struct pcb_t *caller, struct sc_regs *regs)
 {
    /*
@@ -35,12 +48,16 @@ int __sys_ni_syscall(struct pcb_t *caller, struct sc_regs *regs)
    return 0;
 }
 
-#define __SYSCALL(nr, sym) case nr: return __##sym(caller,regs);
+#define __SYSCALL(nr, sym) case nr: \
+	caller->perf.syscalls[PERF_SC_##sym]++; \
+	return __##sym(caller,regs);
 int syscall(struct pcb_t *caller, uint32_t nr, struct sc_regs* regs)
 {
 	switch (nr) {
 	#include "syscalltbl.lst"
-	default: return __sys_ni_syscall(caller, regs);
+	default:
+		caller->perf.syscalls[PERF_SC_OTHER]++;
+		return __sys_ni_syscall(caller, regs);
 	}
 };
 
@@ -1,8 +1,28 @@
-
 #include "timer.h"
+#include "trace.h"
+#include "event.h"
 #include <stdio.h>
 #include <stdlib.h>
 
+/* The devices and the timer thread meet at a central sense-reversing
+ * barrier at the end of every slot. Arriving is a single atomic
+ * decrement of [remaining], the last thread to arrive ends the slot and
+ * flips [sense] (a generation counter, so no thread can confuse two
+ * consecutive slots) and a single broadcast releases every waiter. There
+ * is no per-device lock and no thread walks the device list on the slot
+ * path, so the cost of a slot stays flat with the number of CPUs.
+ *
+ * The waiters block on condition variables rather than raw futexes: the
+ * simulated syscall() in syscall.c shadows the libc one.
+ *
+ * Parked and sleeping devices leave the barrier: [members] counts the
+ * threads expected at the next slot and is what [remaining] is reset to.
+ *
+ * Within a slot, wait_turn() orders the devices by rank: a device is
+ * through with a slot once it has arrived, or while it is out of the
+ * barrier. Only the threads waiting for their turn are signalled.
+ */
+
 static pthread_t _timer;
 
 struct timer_id_container_t {
@@ -11,47 +31,174 @@ struct timer_id_container_t {
 };
 
 static struct timer_id_container_t * dev_list = NULL;
+static int nr_devs = 0;
 
+/* Also read by the trace writer, which is not a member of the barrier:
+ * once it sees the time past a slot, every record of that slot is in */
 static uint64_t _time;
 
 static int timer_started = 0;
-static int timer_stop = 0;
 
+static uint32_t sense = 0;
+static int remaining;
+static int members;
+/* Attached devices which have not called detach_event() yet, and
+ * their number when the current slot started */
+static int nr_live;
+static int slot_live;
+static pthread_mutex_t slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t slot_cond = PTHREAD_COND_INITIALIZER;
 
-static void * timer_routine(void * args) {
-	while (!timer_stop) {
-		printf("Time slot %3lu\n", current_time());
-		int fsh = 0;
-		int event = 0;
-		/* Wait for all devices have done the job in current
-		 * time slot */
-		struct timer_id_container_t * temp;
-		for (temp = dev_list; temp != NULL; temp = temp->next) {
-			pthread_mutex_lock(&temp->id.event_lock);
-			while (!temp->id.done && !temp->id.fsh) {
-				pthread_cond_wait(
-					&temp->id.event_cond,
-					&temp->id.event_lock
-				);
+/* Threads blocked in wait_turn() */
+static pthread_mutex_t turn_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t turn_cond = PTHREAD_COND_INITIALIZER;
+static int nr_turn_waiters = 0;
+
+/* Sleeping devices, only walked by the thread ending a slot */
+static pthread_mutex_t sleep_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sleep_cond = PTHREAD_COND_INITIALIZER;
+static int nr_asleep = 0;
+/* Earliest wake up among the sleeping devices */
+static uint64_t min_wake = UINT64_MAX;
+
+/* Parked devices. wake_gen counts wake_parked() calls so that a wake up
+ * racing with park_slot() is not lost */
+static pthread_mutex_t park_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t park_cond = PTHREAD_COND_INITIALIZER;
+static unsigned long wake_gen = 0;
+static int nr_parked = 0;
+
+/* Block until the slot whose sense was [gen] has ended */
+static void wait_sense(uint32_t gen) {
+	if (__atomic_load_n(&sense, __ATOMIC_ACQUIRE) != gen) {
+		return;
+	}
+	pthread_mutex_lock(&slot_lock);
+	while (__atomic_load_n(&sense, __ATOMIC_ACQUIRE) == gen) {
+		pthread_cond_wait(&slot_cond, &slot_lock);
+	}
+	pthread_mutex_unlock(&slot_lock);
+}
+
+/* Run by the last thread to arrive, every other member is blocked */
+static void end_slot(void) {
+	struct timer_id_container_t * temp;
+
+	/* Increase the time slot */
+	__atomic_add_fetch(&_time, 1, __ATOMIC_RELEASE);
+
+	if (__atomic_load_n(&nr_asleep, __ATOMIC_ACQUIRE) > 0) {
+		/* Only the timer is left running, nothing can happen
+		 * before the earliest wake up so jump straight to it */
+		if (__atomic_load_n(&members, __ATOMIC_ACQUIRE) == 1) {
+			while (_time < min_wake) {
+				print_slot();
+				__atomic_add_fetch(&_time, 1, __ATOMIC_RELEASE);
 			}
-			if (temp->id.fsh) {
-				fsh++;
+		}
+
+		/* The sleepers only registered before arriving, so nobody
+		 * updates min_wake while we read it */
+		if (_time >= min_wake) {
+			pthread_mutex_lock(&sleep_lock);
+			min_wake = UINT64_MAX;
+			for (temp = dev_list; temp != NULL; temp = temp->next) {
+				if (!temp->id.asleep) {
+					continue;
+				}
+				if (temp->id.wake_time > _time) {
+					if (temp->id.wake_time < min_wake) {
+						min_wake = temp->id.wake_time;
+					}
+					continue;
+				}
+				/* Rejoin in the slot starting now */
+				__atomic_add_fetch(&members, 1, __ATOMIC_SEQ_CST);
+				__atomic_sub_fetch(&nr_asleep, 1, __ATOMIC_SEQ_CST);
+				temp->id.wait_sense = sense;
+				__atomic_store_n(&temp->id.asleep, 0, __ATOMIC_SEQ_CST);
 			}
-			event++;
-			pthread_mutex_unlock(&temp->id.event_lock);
+			pthread_cond_broadcast(&sleep_cond);
+			pthread_mutex_unlock(&sleep_lock);
 		}
+	}
 
-		/* Increase the time slot */
-		_time++;
-		
-		/* Let devices continue their job */
-		for (temp = dev_list; temp != NULL; temp = temp->next) {
-			pthread_mutex_lock(&temp->id.timer_lock);
-			temp->id.done = 0;
-			pthread_cond_signal(&temp->id.timer_cond);
-			pthread_mutex_unlock(&temp->id.timer_lock);
+	__atomic_store_n(&remaining,
+		__atomic_load_n(&members, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+	__atomic_store_n(&slot_live,
+		__atomic_load_n(&nr_live, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+	pthread_mutex_lock(&slot_lock);
+	__atomic_add_fetch(&sense, 1, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&slot_cond);
+	pthread_mutex_unlock(&slot_lock);
+}
+
+/* Arrive at the barrier without waiting for the slot to end. [timer_id]
+ * is NULL for the timer thread, which takes no turn */
+static void arrive(struct timer_id_t * timer_id) {
+	if (timer_id != NULL) {
+		__atomic_store_n(&timer_id->done_sense,
+			__atomic_load_n(&sense, __ATOMIC_ACQUIRE),
+			__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&nr_turn_waiters, __ATOMIC_SEQ_CST) > 0) {
+			pthread_mutex_lock(&turn_lock);
+			pthread_cond_broadcast(&turn_cond);
+			pthread_mutex_unlock(&turn_lock);
+		}
+	}
+	if (__atomic_sub_fetch(&remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+		end_slot();
+	}
+}
+
+/* Arrive at the barrier and wait for the next slot */
+static void arrive_wait(struct timer_id_t * timer_id) {
+	uint32_t gen = __atomic_load_n(&sense, __ATOMIC_ACQUIRE);
+	arrive(timer_id);
+	wait_sense(gen);
+}
+
+/* Whether [dev] is through with the slot whose sense is [gen] */
+static int turn_done(struct timer_id_t * dev, uint32_t gen) {
+	return __atomic_load_n(&dev->fsh, __ATOMIC_SEQ_CST) ||
+		__atomic_load_n(&dev->parked, __ATOMIC_SEQ_CST) ||
+		__atomic_load_n(&dev->asleep, __ATOMIC_SEQ_CST) ||
+		__atomic_load_n(&dev->done_sense, __ATOMIC_SEQ_CST) == gen;
+}
+
+void wait_turn(struct timer_id_t * timer_id) {
+	struct timer_id_container_t * temp;
+	uint32_t gen = __atomic_load_n(&sense, __ATOMIC_ACQUIRE);
+
+	for (temp = dev_list; temp != NULL; temp = temp->next) {
+		if (temp->id.rank >= timer_id->rank ||
+				turn_done(&temp->id, gen)) {
+			continue;
 		}
-		if (fsh == event) {
+		pthread_mutex_lock(&turn_lock);
+		__atomic_add_fetch(&nr_turn_waiters, 1, __ATOMIC_SEQ_CST);
+		while (!turn_done(&temp->id, gen)) {
+			pthread_cond_wait(&turn_cond, &turn_lock);
+		}
+		__atomic_sub_fetch(&nr_turn_waiters, 1, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&turn_lock);
+	}
+	/* The wake ups so far are for the devices ahead, park_slot() only
+	 * heeds the ones following this turn */
+	timer_id->wake_seen = __atomic_load_n(&wake_gen, __ATOMIC_SEQ_CST);
+}
+
+static void * timer_routine(void * args) {
+	trace_attach(TRACE_TIMER);
+	/* Runs until no device is left, stop_timer() only joins it */
+	while (1) {
+		print_slot();
+		/* Wait for all devices have done the job in current
+		 * time slot */
+		arrive_wait(NULL);
+		/* A device detaching in the new slot has still worked in
+		 * it, the slot is logged */
+		if (__atomic_load_n(&slot_live, __ATOMIC_ACQUIRE) == 0) {
 			break;
 		}
 	}
@@ -59,37 +206,143 @@ static void * timer_routine(void * args) {
 }
 
 void next_slot(struct timer_id_t * timer_id) {
-	/* Tell to timer that we have done our job in current slot */
-	pthread_mutex_lock(&timer_id->event_lock);
-	timer_id->done = 1;
-	pthread_cond_signal(&timer_id->event_cond);
-	pthread_mutex_unlock(&timer_id->event_lock);
+	/* Tell to timer that we have done our job in current slot and
+	 * wait for going to next slot */
+	arrive_wait(timer_id);
+	timer_id->wake_seen = __atomic_load_n(&wake_gen, __ATOMIC_SEQ_CST);
+}
+
+/* Out of the barrier until another thread clears [*flag] under
+ * [lock], then resume in the slot following [wait_sense] */
+static void wait_rejoin(struct timer_id_t * timer_id, int * flag,
+		pthread_mutex_t * lock, pthread_cond_t * cond) {
+	pthread_mutex_lock(lock);
+	while (*flag) {
+		pthread_cond_wait(cond, lock);
+	}
+	pthread_mutex_unlock(lock);
+	wait_sense(timer_id->wait_sense);
+	timer_id->wake_seen = __atomic_load_n(&wake_gen, __ATOMIC_SEQ_CST);
+}
+
+void leave_until(struct timer_id_t * timer_id, uint64_t time) {
+	if (current_time() + 1 >= time) {
+		/* Nothing to leave, rejoin_slot() is a plain next_slot() */
+		return;
+	}
+
+	/* Done for every slot until [time], the thread ending the slot
+	 * before it lets us back in */
+	pthread_mutex_lock(&sleep_lock);
+	timer_id->wake_time = time;
+	__atomic_store_n(&timer_id->asleep, 1, __ATOMIC_SEQ_CST);
+	timer_id->away = 1;
+	if (time < min_wake) {
+		min_wake = time;
+	}
+	__atomic_add_fetch(&nr_asleep, 1, __ATOMIC_SEQ_CST);
+	__atomic_sub_fetch(&members, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&sleep_lock);
 
-	/* Wait for going to next slot */
-	pthread_mutex_lock(&timer_id->timer_lock);
-	while (timer_id->done) {
-		pthread_cond_wait(
-			&timer_id->timer_cond,
-			&timer_id->timer_lock
-		);
+	arrive(timer_id);
+}
+
+void rejoin_slot(struct timer_id_t * timer_id) {
+	if (timer_id->away) {
+		timer_id->away = 0;
+		wait_rejoin(timer_id, &timer_id->asleep, &sleep_lock, &sleep_cond);
+	}else{
+		next_slot(timer_id);
+	}
+}
+
+void sleep_until(struct timer_id_t * timer_id, uint64_t time) {
+	if (current_time() >= time) {
+		return;
+	}
+	leave_until(timer_id, time);
+	rejoin_slot(timer_id);
+}
+
+void park_slot(struct timer_id_t * timer_id) {
+	pthread_mutex_lock(&park_lock);
+	__atomic_add_fetch(&nr_parked, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&wake_gen, __ATOMIC_SEQ_CST) != timer_id->wake_seen) {
+		/* Woken up during this slot already, just poll next slot */
+		__atomic_sub_fetch(&nr_parked, 1, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&park_lock);
+		next_slot(timer_id);
+		return;
+	}
+	__atomic_store_n(&timer_id->parked, 1, __ATOMIC_SEQ_CST);
+	__atomic_sub_fetch(&members, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&park_lock);
+
+	arrive(timer_id);
+	wait_rejoin(timer_id, &timer_id->parked, &park_lock, &park_cond);
+	__atomic_sub_fetch(&nr_parked, 1, __ATOMIC_SEQ_CST);
+}
+
+void wake_parked() {
+	struct timer_id_container_t * temp;
+
+	__atomic_add_fetch(&wake_gen, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&nr_parked, __ATOMIC_SEQ_CST) == 0) {
+		return;
+	}
+
+	/* The caller has not arrived yet, so the slot cannot end under
+	 * us: a parked device is counted as arrived for this slot and
+	 * expected again from the next one */
+	pthread_mutex_lock(&park_lock);
+	for (temp = dev_list; temp != NULL; temp = temp->next) {
+		if (!temp->id.parked) {
+			continue;
+		}
+		__atomic_add_fetch(&members, 1, __ATOMIC_SEQ_CST);
+		temp->id.wait_sense = __atomic_load_n(&sense, __ATOMIC_ACQUIRE);
+		__atomic_store_n(&temp->id.done_sense, temp->id.wait_sense,
+			__ATOMIC_SEQ_CST);
+		__atomic_store_n(&temp->id.parked, 0, __ATOMIC_SEQ_CST);
+	}
+	pthread_cond_broadcast(&park_cond);
+	pthread_mutex_unlock(&park_lock);
+}
+
+unsigned long wake_count() {
+	return __atomic_load_n(&wake_gen, __ATOMIC_SEQ_CST);
+}
+
+void print_slot() {
+	TRACE_EVENT(TRACE_SCHED, EV_SLOT, 0, (0),
+		"Time slot %3lu\n", current_time());
+}
+
+void advance_time(uint64_t time) {
+	_time++;
+	while (_time < time) {
+		print_slot();
+		_time++;
 	}
-	pthread_mutex_unlock(&timer_id->timer_lock);
 }
 
 uint64_t current_time() {
-	return _time;
+	return __atomic_load_n(&_time, __ATOMIC_ACQUIRE);
 }
 
 void start_timer() {
 	timer_started = 1;
+	/* Every device plus the timer thread itself */
+	members = nr_live + 1;
+	remaining = members;
 	pthread_create(&_timer, NULL, timer_routine, NULL);
 }
 
 void detach_event(struct timer_id_t * event) {
-	pthread_mutex_lock(&event->event_lock);
-	event->fsh = 1;
-	pthread_cond_signal(&event->event_cond);
-	pthread_mutex_unlock(&event->event_lock);
+	__atomic_store_n(&event->fsh, 1, __ATOMIC_SEQ_CST);
+	__atomic_sub_fetch(&nr_live, 1, __ATOMIC_SEQ_CST);
+	__atomic_sub_fetch(&members, 1, __ATOMIC_SEQ_CST);
+	arrive(event);
 }
 
 struct timer_id_t * attach_event() {
@@ -98,14 +351,18 @@ struct timer_id_t * attach_event() {
 	}else{
 		struct timer_id_container_t * container =
 			(struct timer_id_container_t*)malloc(
-				sizeof(struct timer_id_container_t)		
+				sizeof(struct timer_id_container_t)
 			);
-		container->id.done = 0;
 		container->id.fsh = 0;
-		pthread_cond_init(&container->id.event_cond, NULL);
-		pthread_mutex_init(&container->id.event_lock, NULL);
-		pthread_cond_init(&container->id.timer_cond, NULL);
-		pthread_mutex_init(&container->id.timer_lock, NULL);
+		container->id.parked = 0;
+		container->id.asleep = 0;
+		container->id.away = 0;
+		container->id.wait_sense = 0;
+		container->id.wake_seen = 0;
+		container->id.wake_time = 0;
+		container->id.rank = nr_devs++;
+		container->id.done_sense = UINT32_MAX;
+		nr_live++;
 		if (dev_list == NULL) {
 			dev_list = container;
 			dev_list->next = NULL;
@@ -118,19 +375,13 @@ struct timer_id_t * attach_event() {
 }
 
 void stop_timer() {
-	timer_stop = 1;
 	pthread_join(_timer, NULL);
 	while (dev_list != NULL) {
 		struct timer_id_container_t * temp = dev_list;
 		dev_list = dev_list->next;
-		pthread_cond_destroy(&temp->id.event_cond);
-		pthread_mutex_destroy(&temp->id.event_lock);
-		pthread_cond_destroy(&temp->id.timer_cond);
-		pthread_mutex_destroy(&temp->id.timer_lock);
 		free(temp);
 	}
 }
 
 
 
-
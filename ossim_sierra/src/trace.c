@@ -0,0 +1,383 @@
+
+/*
+ * Trace records
+ *
+ * Each thread appends its records to a queue of chunks only it writes,
+ * the writer thread is the only reader. A record is published by a
+ * release store of the chunk tail. A full chunk is closed by a release
+ * store of its next pointer as soon as the next chunk is set up, before
+ * any record goes in: its tail is final by then, and the records of the
+ * next chunk are published by that chunk's own tail. Neither side ever
+ * waits for the other.
+ *
+ * All the records of slot t are in their queues once the clock has
+ * moved past t: a thread only logs before arriving at the slot barrier.
+ * The writer merges the queues up to that watermark.
+ */
+
+#include "trace.h"
+#include "timer.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TRACE_CHUNK_SIZE (64 * 1024)
+/* Writer polling period when it has caught up, in nanoseconds */
+#define TRACE_POLL_NS 1000000
+
+struct trace_rec_t {
+	uint64_t slot;
+	uint32_t len;		/* Data length, the data follows */
+	uint32_t bin;		/* Binary record rather than text */
+};
+
+struct trace_chunk_t {
+	struct trace_chunk_t *next;
+	size_t size;
+	size_t tail;		/* Published end of the records */
+	size_t head;		/* Next record to print, writer only */
+	char data[];
+};
+
+struct trace_buf_t {
+	int source;
+	struct trace_chunk_t *write;	/* Owner thread only */
+	struct trace_chunk_t *read;	/* Writer only */
+	struct trace_buf_t *next;
+};
+
+unsigned int trace_mask = TRACE_ALL;
+
+static const struct {
+	const char *name;
+	unsigned int mask;
+} trace_cats[] = {
+	{"sched", TRACE_SCHED},
+	{"io", TRACE_IO},
+	{"pgtbl", TRACE_PGTBL},
+	{"memdump", TRACE_MEMDUMP},
+	{"memio", TRACE_MEMIO},
+	{"syscall", TRACE_SYSCALL},
+	{"all", TRACE_ALL},
+};
+
+/* Categories of each level */
+static const unsigned int trace_levels[] = {
+	0,
+	TRACE_SCHED,
+	TRACE_SCHED | TRACE_IO | TRACE_SYSCALL,
+	TRACE_ALL,
+};
+
+static struct trace_buf_t *bufs;
+/* Where binary records go, they are dropped without it */
+static FILE *bin_file = NULL;
+static __thread struct trace_buf_t *self;
+static __thread int self_source = TRACE_OTHER;
+
+static pthread_t writer;
+static int running = 0;
+static int stopping = 0;
+static pthread_mutex_t stop_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stop_cond = PTHREAD_COND_INITIALIZER;
+
+static size_t rec_size(uint32_t len)
+{
+	/* With room for the terminating null vsnprintf() writes */
+	return (sizeof(struct trace_rec_t) + len + 8) & ~(size_t)7;
+}
+
+static struct trace_chunk_t *new_chunk(size_t need)
+{
+	size_t size = (need > TRACE_CHUNK_SIZE) ? need : TRACE_CHUNK_SIZE;
+	struct trace_chunk_t *chunk = malloc(sizeof(*chunk) + size);
+
+	if (chunk == NULL)
+		return NULL;
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->tail = 0;
+	chunk->head = 0;
+	return chunk;
+}
+
+static struct trace_buf_t *new_buf(void)
+{
+	struct trace_buf_t *buf = malloc(sizeof(*buf));
+
+	if (buf == NULL)
+		return NULL;
+	buf->source = self_source;
+	buf->write = buf->read = new_chunk(0);
+	if (buf->write == NULL)
+	{
+		free(buf);
+		return NULL;
+	}
+	buf->next = __atomic_load_n(&bufs, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&bufs, &buf->next, buf, 1,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+	return buf;
+}
+
+int trace_parse(const char *spec)
+{
+	char buf[128], *name, *save;
+	unsigned int mask = trace_mask;
+	size_t i, n = sizeof(trace_cats) / sizeof(trace_cats[0]);
+	int off;
+
+	if (spec[0] >= '0' && spec[0] <= '3' && spec[1] == '\0')
+	{
+		trace_mask = trace_levels[spec[0] - '0'];
+		return 0;
+	}
+
+	/* A plain list replaces the categories, a signed one edits them */
+	if (spec[0] != '-' && spec[0] != '+')
+		mask = 0;
+	snprintf(buf, sizeof(buf), "%s", spec);
+	for (name = strtok_r(buf, ",", &save); name != NULL;
+			name = strtok_r(NULL, ",", &save))
+	{
+		if ((off = (name[0] == '-')) || name[0] == '+')
+			name++;
+		for (i = 0; i < n && strcmp(name, trace_cats[i].name); i++)
+			;
+		if (i == n)
+			return -1;
+		if (off)
+			mask &= ~trace_cats[i].mask;
+		else
+			mask |= trace_cats[i].mask;
+	}
+	trace_mask = mask;
+	return 0;
+}
+
+void trace_attach(int source)
+{
+	self_source = source;
+	if (self != NULL)
+		self->source = source;
+}
+
+/* The buffer of the calling thread, NULL if records are not queued */
+static struct trace_buf_t *get_buf(void)
+{
+	if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE))
+		return NULL;
+	if (self == NULL)
+		self = new_buf();
+	return self;
+}
+
+/* The end of the queue, in a new chunk when the [len] bytes of a record
+ * do not fit in the current one. The writer only moves to the new chunk
+ * once it has printed the records of the old one */
+static struct trace_rec_t *reserve(uint32_t len)
+{
+	struct trace_chunk_t *chunk = self->write;
+
+	if (rec_size(len) > chunk->size - chunk->tail)
+	{
+		if ((chunk = new_chunk(rec_size(len))) == NULL)
+			return NULL;
+		__atomic_store_n(&self->write->next, chunk, __ATOMIC_RELEASE);
+		self->write = chunk;
+	}
+	return (struct trace_rec_t *)(chunk->data + chunk->tail);
+}
+
+static void publish(struct trace_rec_t *rec, uint32_t len, int bin)
+{
+	struct trace_chunk_t *chunk = self->write;
+
+	rec->slot = current_time();
+	rec->len = len;
+	rec->bin = bin;
+	__atomic_store_n(&chunk->tail, chunk->tail + rec_size(len),
+		__ATOMIC_RELEASE);
+}
+
+void trace_printf(const char *fmt, ...)
+{
+	struct trace_chunk_t *chunk;
+	struct trace_rec_t *rec;
+	size_t room;
+	va_list ap, again;
+	int len;
+
+	va_start(ap, fmt);
+	if (get_buf() == NULL)
+	{
+		vprintf(fmt, ap);
+		va_end(ap);
+		return;
+	}
+
+	/* Format in place, again in a new chunk if it does not fit */
+	chunk = self->write;
+	room = chunk->size - chunk->tail;
+	rec = (struct trace_rec_t *)(chunk->data + chunk->tail);
+	va_copy(again, ap);
+	len = vsnprintf((char *)(rec + 1),
+		room > sizeof(*rec) ? room - sizeof(*rec) : 0, fmt, ap);
+	if (len < 0)
+		len = 0;
+	if (rec_size(len) > room)
+	{
+		if ((rec = reserve(len)) != NULL)
+			vsnprintf((char *)(rec + 1), len + 1, fmt, again);
+	}
+	va_end(again);
+	va_end(ap);
+
+	if (rec != NULL)
+		publish(rec, len, 0);
+}
+
+void trace_write(const void *data, uint32_t len)
+{
+	struct trace_rec_t *rec;
+
+	if (get_buf() == NULL)
+	{
+		if (bin_file != NULL)
+			fwrite(data, 1, len, bin_file);
+		return;
+	}
+	if ((rec = reserve(len)) == NULL)
+		return;
+	memcpy(rec + 1, data, len);
+	publish(rec, len, 1);
+}
+
+void trace_bin_file(FILE *file)
+{
+	bin_file = file;
+}
+
+/* The oldest unprinted record of [buf], NULL if there is none yet */
+static struct trace_rec_t *peek(struct trace_buf_t *buf)
+{
+	struct trace_chunk_t *chunk = buf->read, *next;
+
+	while (1)
+	{
+		if (chunk->head < __atomic_load_n(&chunk->tail, __ATOMIC_ACQUIRE))
+			return (struct trace_rec_t *)(chunk->data + chunk->head);
+		if ((next = __atomic_load_n(&chunk->next, __ATOMIC_ACQUIRE)) == NULL)
+			return NULL;
+		/* The tail was final before next was set */
+		if (chunk->head < __atomic_load_n(&chunk->tail, __ATOMIC_ACQUIRE))
+			continue;
+		buf->read = next;
+		free(chunk);
+		chunk = next;
+	}
+}
+
+/* Print the records of the slots before [watermark] in timeline order,
+ * return the number printed */
+static int drain(uint64_t watermark)
+{
+	struct trace_buf_t *buf, *best;
+	struct trace_rec_t *rec, *first;
+	int n = 0;
+
+	while (1)
+	{
+		best = NULL;
+		first = NULL;
+		for (buf = __atomic_load_n(&bufs, __ATOMIC_ACQUIRE); buf != NULL;
+				buf = buf->next)
+		{
+			if ((rec = peek(buf)) == NULL || rec->slot >= watermark)
+				continue;
+			if (first == NULL || rec->slot < first->slot ||
+				(rec->slot == first->slot && buf->source < best->source))
+			{
+				best = buf;
+				first = rec;
+			}
+		}
+		if (best == NULL)
+			return n;
+		if (!first->bin)
+			fwrite(first + 1, 1, first->len, stdout);
+		else if (bin_file != NULL)
+			fwrite(first + 1, 1, first->len, bin_file);
+		best->read->head += rec_size(first->len);
+		n++;
+	}
+}
+
+static void *writer_routine(void *args)
+{
+	struct timespec ts;
+
+	pthread_mutex_lock(&stop_lock);
+	while (!stopping)
+	{
+		pthread_mutex_unlock(&stop_lock);
+		if (drain(current_time()) == 0)
+		{
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += TRACE_POLL_NS;
+			if (ts.tv_nsec >= 1000000000)
+			{
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+			pthread_mutex_lock(&stop_lock);
+			if (!stopping)
+				pthread_cond_timedwait(&stop_cond, &stop_lock, &ts);
+			continue;
+		}
+		pthread_mutex_lock(&stop_lock);
+	}
+	pthread_mutex_unlock(&stop_lock);
+	return args;
+}
+
+void trace_start(void)
+{
+	stopping = 0;
+	__atomic_store_n(&running, 1, __ATOMIC_RELEASE);
+	pthread_create(&writer, NULL, writer_routine, NULL);
+}
+
+void trace_stop(void)
+{
+	struct trace_buf_t *buf;
+
+	if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE))
+		return;
+
+	pthread_mutex_lock(&stop_lock);
+	stopping = 1;
+	pthread_cond_signal(&stop_cond);
+	pthread_mutex_unlock(&stop_lock);
+	pthread_join(writer, NULL);
+
+	/* Every other thread is done logging */
+	__atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+	drain(UINT64_MAX);
+	fflush(stdout);
+	if (bin_file != NULL)
+		fflush(bin_file);
+
+	while ((buf = bufs) != NULL)
+	{
+		bufs = buf->next;
+		free(buf->read);
+		free(buf);
+	}
+	self = NULL;
+}